@@ -0,0 +1,145 @@
+#include "Apa102Driver.h"
+#include "LedUtils.h"
+#include "MemoryBudget.h"
+
+#define APA102_START_FRAME_BYTES 4
+#define APA102_PIXEL_BYTES 4
+#define SK9822_RESET_FRAME_BYTES 4
+
+Apa102Driver::Apa102Driver(uint8_t dataPin, uint8_t clockPin, uint32_t frequency)
+{
+    _chipset = LedChipset::apa102;
+    _dataPin = dataPin;
+    _clockPin = clockPin;
+    _frequency = frequency;
+}
+
+bool Apa102Driver::begin(LedChipset chipset, uint16_t pixelCount)
+{
+    if (chipset != LedChipset::apa102 && chipset != LedChipset::sk9822)
+        return false;
+
+    _chipset = chipset;
+    _pixelCount = pixelCount;
+    _bufferLength = APA102_START_FRAME_BYTES + pixelCount * APA102_PIXEL_BYTES + EndFrameBytes(_chipset, pixelCount);
+    _buffer = static_cast<uint8_t *>(MemoryBudget::allocate(MemorySubsystem::ledBuffers, _bufferLength));
+
+    if (_buffer == nullptr)
+        return false;
+
+    // start frame: 32 zero bits
+    memset(_buffer, 0, APA102_START_FRAME_BYTES);
+
+    // end frame: APA102 wants ones, SK9822 a reset frame of zeros followed by more zeros
+    uint8_t endByte = _chipset == LedChipset::apa102 ? 0xFF : 0x00;
+    memset(_buffer + APA102_START_FRAME_BYTES + pixelCount * APA102_PIXEL_BYTES, endByte, EndFrameBytes(_chipset, pixelCount));
+
+    setBrightness(_brightness);
+    clear();
+
+    _spi = &SPI;
+    _spi->begin(_clockPin, -1, _dataPin, -1);
+
+    return true;
+}
+
+uint8_t *Apa102Driver::pixelBytes(uint16_t index)
+{
+    return _buffer + APA102_START_FRAME_BYTES + index * APA102_PIXEL_BYTES;
+}
+
+void Apa102Driver::setPixel(uint16_t index, uint32_t color)
+{
+    if (index >= _pixelCount)
+        return;
+
+    EncodePixel(pixelBytes(index), color, _header);
+}
+
+void Apa102Driver::setBrightness(uint8_t brightness)
+{
+    _brightness = brightness;
+
+    // 8 bit brightness to 5 bit, anything above 0 stays visible
+    uint8_t global = (brightness + 7) >> 3;
+    if (global > 31)
+        global = 31;
+
+    _header = 0xE0 | global;
+
+    for (uint16_t i = 0; i < _pixelCount; i++)
+    {
+        pixelBytes(i)[0] = _header;
+    }
+}
+
+uint8_t Apa102Driver::getBrightness()
+{
+    return _brightness;
+}
+
+void Apa102Driver::clear()
+{
+    for (uint16_t i = 0; i < _pixelCount; i++)
+    {
+        EncodePixel(pixelBytes(i), 0, _header);
+    }
+}
+
+void Apa102Driver::show()
+{
+    if (_spi == nullptr)
+        return;
+
+    _spi->beginTransaction(SPISettings(_frequency, MSBFIRST, SPI_MODE0));
+    _spi->writeBytes(_buffer, _bufferLength);
+    _spi->endTransaction();
+}
+
+uint16_t Apa102Driver::numPixels()
+{
+    return _pixelCount;
+}
+
+size_t Apa102Driver::frameBytes()
+{
+    return _bufferLength;
+}
+
+uint32_t Apa102Driver::wireMicros()
+{
+    // there is no latch, the frame is done once the last bit is clocked out
+    return (uint64_t)_bufferLength * 8 * 1000000 / _frequency;
+}
+
+LedChipset Apa102Driver::chipset()
+{
+    return _chipset;
+}
+
+const uint8_t *Apa102Driver::getBuffer()
+{
+    return _buffer;
+}
+
+void Apa102Driver::EncodePixel(uint8_t *out, uint32_t color, uint8_t header)
+{
+    // there is no white LED, add the white channel to red, green and blue
+    uint8_t white = color >> 24;
+    color = LedUtils::AddSaturate(color & 0x00FFFFFF, white * 0x00010101);
+
+    out[0] = header;
+    out[1] = color;         // blue
+    out[2] = color >> 8;    // green
+    out[3] = color >> 16;   // red
+}
+
+size_t Apa102Driver::EndFrameBytes(LedChipset chipset, uint16_t pixelCount)
+{
+    size_t clockBytes = (pixelCount + 15) / 16;
+
+    if (chipset == LedChipset::sk9822)
+        return SK9822_RESET_FRAME_BYTES + clockBytes;
+
+    return clockBytes;
+}
@@ -0,0 +1,69 @@
+#ifndef __APA102DRIVER_H__
+#define __APA102DRIVER_H__
+
+#include "SPI.h"
+#include "LedDriver.h"
+
+#ifndef SPI_LED_FREQUENCY
+#define SPI_LED_FREQUENCY 8000000
+#endif
+
+/**
+ * @brief Clocked SPI strips (APA102, SK9822).
+ *
+ * The frame is kept encoded in the wire format, setPixel writes the 4 bytes of a LED
+ * and show() hands the whole buffer to the SPI peripheral. The brightness goes into
+ * the 5 bit global brightness of every LED instead of scaling the colors, so dimmed
+ * colors keep their full 8 bit resolution.
+ */
+class Apa102Driver : public LedDriver
+{
+private:
+    LedChipset _chipset;
+    uint8_t _dataPin;
+    uint8_t _clockPin;
+    uint32_t _frequency;
+    uint16_t _pixelCount = 0;
+    uint8_t _brightness = 255;
+    uint8_t _header = 0xFF;     // 0b111 + 5 bit global brightness
+    uint8_t *_buffer = nullptr;
+    size_t _bufferLength = 0;
+    SPIClass *_spi = nullptr;
+
+    uint8_t *pixelBytes(uint16_t index);
+
+public:
+    Apa102Driver(uint8_t dataPin, uint8_t clockPin, uint32_t frequency = SPI_LED_FREQUENCY);
+
+    bool begin(LedChipset chipset, uint16_t pixelCount) override;
+    void setPixel(uint16_t index, uint32_t color) override;
+    void setBrightness(uint8_t brightness) override;
+    uint8_t getBrightness() override;
+    void clear() override;
+    void show() override;
+    uint16_t numPixels() override;
+    size_t frameBytes() override;
+    uint32_t wireMicros() override;
+    LedChipset chipset() override;
+
+    /**
+     * @brief The encoded frame, start frame, LEDs and end frame as they go on the wire
+     */
+    const uint8_t *getBuffer();
+
+    /**
+     * @brief Encode a packed WRGB color into the 4 bytes of one LED, white is mixed into RGB
+     *
+     * @param out The 4 bytes to fill
+     * @param color The color
+     * @param header The brightness byte (0xE0 | 5 bit brightness)
+     */
+    static void EncodePixel(uint8_t *out, uint32_t color, uint8_t header);
+
+    /**
+     * @brief The length of the end frame, the clock has to run half a cycle per LED more
+     */
+    static size_t EndFrameBytes(LedChipset chipset, uint16_t pixelCount);
+};
+
+#endif // __APA102DRIVER_H__
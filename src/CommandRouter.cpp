@@ -0,0 +1,107 @@
+#include "CommandRouter.h"
+#include "ArduinoJson.h"
+#include "LightStateJson.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+
+CommandRouter::CommandRouter(LedController *ledController, PresetStore *presetStore, DeviceUtils *deviceUtils)
+{
+    _ledController = ledController;
+    _presetStore = presetStore;
+    _deviceUtils = deviceUtils;
+}
+
+bool CommandRouter::applyCommand(const char *payload, size_t len, CommandTrace *trace)
+{
+    STATIC_MEMORY_STORAGE StaticJsonDocument<JSON_DOCUMENT_SIZE> jsonDoc;
+    DeserializationError error = deserializeJson(jsonDoc, payload, len);
+
+    if (error)
+    {
+        LOG_WARN("command could not be parsed: '%s'", error.c_str());
+        return false;
+    }
+
+    LOG_DEBUG_TEXT(LOG_MQTT, "command: %s", payload, len);
+
+    LightStateUpdate stateUpdate = LightStateUpdate();
+    LightStateJson::Parse(jsonDoc, &stateUpdate);
+    trace->parsedMicros = micros();
+
+    _ledController->setState(stateUpdate);
+    trace->appliedMicros = micros();
+    _ledController->traceCommand(trace);
+
+    return true;
+}
+
+bool CommandRouter::recallPreset(uint8_t id, CommandTrace *trace)
+{
+    const LightPreset *preset = _presetStore->get(id);
+
+    if (preset == nullptr)
+    {
+        LOG_WARN("preset %u does not exist", id);
+        return false;
+    }
+
+    // there is nothing to parse, the preset is applied by the next frame
+    trace->parsedMicros = micros();
+    trace->appliedMicros = trace->parsedMicros;
+    _ledController->traceCommand(trace);
+    _ledController->recallPreset(preset);
+
+    return true;
+}
+
+CommandTopic CommandRouter::route(const char *topic, const char *payload, size_t len, CommandTrace *trace, bool *applied)
+{
+    *applied = false;
+
+    if (strcmp(topic, _deviceUtils->GetCommandTopic()) == 0)
+    {
+        *applied = applyCommand(payload, len, trace);
+        return CommandTopic::topicCommand;
+    }
+
+    if (strcmp(topic, _deviceUtils->GetPresetTopic()) == 0)
+    {
+        uint8_t id;
+
+        if (ParsePresetId(payload, len, &id))
+            *applied = recallPreset(id, trace);
+        else
+            LOG_WARN("invalid preset id received");
+
+        return CommandTopic::topicPreset;
+    }
+
+    return CommandTopic::topicUnknown;
+}
+
+bool CommandRouter::ParsePresetId(const char *payload, size_t len, uint8_t *id)
+{
+    if (len == 1 && !isdigit(payload[0]))
+    {
+        *id = static_cast<uint8_t>(payload[0]);
+        return true;
+    }
+
+    if (len == 0 || len > 3)
+        return false;
+
+    unsigned int value = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isdigit(payload[i]))
+            return false;
+
+        value = value * 10 + (payload[i] - '0');
+    }
+
+    if (value > UINT8_MAX)
+        return false;
+
+    *id = static_cast<uint8_t>(value);
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __COMMANDROUTER_H__
+#define __COMMANDROUTER_H__
+
+#include <Arduino.h>
+#include "DeviceUtils.h"
+#include "LedController.h"
+#include "PresetStore.h"
+
+enum CommandTopic
+{
+    topicUnknown,
+    topicCommand,   // a JSON command in the MQTT state schema
+    topicPreset     // the id of a preset to recall
+};
+
+/**
+ * @brief The single command path for every transport (MQTT, HTTP, WebSocket).
+ *
+ * Parses commands and preset ids and hands them to the controller, publishing the
+ * resulting state is left to the caller.
+ */
+class CommandRouter
+{
+private:
+    LedController *_ledController;
+    PresetStore *_presetStore;
+    DeviceUtils *_deviceUtils;
+
+public:
+    CommandRouter(LedController *ledController, PresetStore *presetStore, DeviceUtils *deviceUtils);
+
+    /**
+     * @brief Parse a command and apply it with the next frame
+     *
+     * @param payload The JSON command, in the same schema as the MQTT state
+     * @param len The length of the payload
+     * @param trace The trace of the command, started when it was received
+     * @return true The command could be parsed and was applied
+     */
+    bool applyCommand(const char *payload, size_t len, CommandTrace *trace);
+
+    /**
+     * @brief Recall a preset from the RAM cache, it gets applied with the next frame
+     *
+     * @param id The id of the preset
+     * @param trace The trace of the command, started when it was received
+     * @return true The preset exists
+     */
+    bool recallPreset(uint8_t id, CommandTrace *trace);
+
+    /**
+     * @brief Dispatch an MQTT message by its topic
+     *
+     * @param topic The topic the message was received on
+     * @param payload The payload, not null terminated
+     * @param len The length of the payload
+     * @param trace The trace of the command, started when it was received
+     * @param applied Set to whether the command or preset was applied
+     * @return CommandTopic The kind of topic, topicUnknown when it is none of this device
+     */
+    CommandTopic route(const char *topic, const char *payload, size_t len, CommandTrace *trace, bool *applied);
+
+    /**
+     * @brief Read a preset id, either a single raw byte or decimal digits ("3")
+     *
+     * @return true A valid id was read
+     */
+    static bool ParsePresetId(const char *payload, size_t len, uint8_t *id);
+};
+
+#endif // __COMMANDROUTER_H__
@@ -0,0 +1,396 @@
+#include "Compositor.h"
+#include "LedUtils.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+#include "Noise.h"
+
+// 16 color gradients for the noise effects, indexed by the noise sample
+static const uint32_t _lavaPalette[16] = {
+    0x000000, 0x120000, 0x2A0000, 0x480000, 0x700000, 0x9A0500, 0xC21500, 0xE02E00,
+    0xF04A00, 0xFF6A00, 0xFF8C00, 0xFFAA10, 0xFFC830, 0xFFE060, 0xFFF0A0, 0xFFFFE0};
+
+static const uint32_t _oceanPalette[16] = {
+    0x000010, 0x000028, 0x000040, 0x000860, 0x001080, 0x0020A0, 0x0038B8, 0x0050C8,
+    0x0068D0, 0x0088D8, 0x10A0E0, 0x20B8E0, 0x40D0E8, 0x70E0F0, 0xB0F0F8, 0xE8FFFF};
+
+static const uint32_t _auroraPalette[16] = {
+    0x000000, 0x000804, 0x001810, 0x00301C, 0x005028, 0x00782C, 0x00A030, 0x10C040,
+    0x20D060, 0x20C080, 0x2098A0, 0x3060B0, 0x5030B0, 0x8020A0, 0xB02090, 0xE040A0};
+
+static bool isParticleEffect(LightEffect effect)
+{
+    return effect == LightEffect::fire || effect == LightEffect::sparkle || effect == LightEffect::meteor || effect == LightEffect::confetti;
+}
+
+bool Compositor::setup(uint16_t pixelCount)
+{
+    _capacity = pixelCount;
+    _pixelCount = pixelCount;
+    _width = pixelCount;
+    _height = 1;
+
+    for (uint8_t i = 0; i < COMPOSITOR_LAYERS; i++)
+    {
+        _layers[i].pixels = static_cast<uint32_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, pixelCount * sizeof(uint32_t)));
+    }
+
+    _frame = static_cast<uint32_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, pixelCount * sizeof(uint32_t)));
+
+    for (uint8_t i = 0; i < COMPOSITOR_LAYERS; i++)
+    {
+        if (_layers[i].pixels == nullptr)
+            _frame = nullptr;
+    }
+
+    if (_frame == nullptr)
+    {
+        LOG_ERROR("compositor buffers could not be allocated");
+        return false;
+    }
+
+    memset(_frame, 0, pixelCount * sizeof(uint32_t));
+    _layers[overlayLayer].blendMode = BlendMode::blendKeyed;
+
+    // without a pool the particle effects stay dark, everything else still works
+    _particles.setup(COMPOSITOR_LAYERS, PARTICLES_PER_OWNER);
+
+    return true;
+}
+
+void Compositor::setBaseEffect(LightEffect effect, uint16_t crossfadeMillis, unsigned long now)
+{
+    EffectLayer *base = &_layers[baseLayer];
+    EffectLayer *fading = &_layers[fadingLayer];
+
+    if (base->effect == effect)
+        return;
+
+    _particles.clear(fadingLayer);
+
+    if (_crossfading && crossfadeMillis > 0)
+    {
+        // interrupting a crossfade: what is on the LEDs right now fades out, frozen, instead of
+        // jumping back to the full outgoing layer
+        for (uint16_t p = 0; p < _pixelCount; p++)
+        {
+            fading->pixels[p] = blend(fading->pixels[p], base->pixels[p], BlendMode::blendOpaque, base->alpha);
+        }
+
+        fading->effect = LightEffect::transition;
+        fading->alpha = 256;
+        _particles.clear(baseLayer);
+
+        _crossfadeStart = now;
+        _crossfadeMillis = crossfadeMillis;
+    }
+    else if (base->effect != LightEffect::unknown && crossfadeMillis > 0)
+    {
+        // the current base becomes the outgoing layer, it keeps its animation state, buffer and particles
+        uint32_t *pixels = fading->pixels;
+        *fading = *base;
+        fading->alpha = 256;
+        base->pixels = pixels;
+        _particles.transfer(baseLayer, fadingLayer);
+
+        _crossfadeStart = now;
+        _crossfadeMillis = crossfadeMillis;
+        _crossfading = true;
+    }
+    else
+    {
+        fading->effect = LightEffect::unknown;
+        _crossfading = false;
+        _particles.clear(baseLayer);
+    }
+
+    base->effect = effect;
+    base->cycle = 0;
+    base->index = 0;
+    base->alpha = _crossfading ? 0 : 256;
+
+    _dirty = true;
+}
+
+void Compositor::setDimensions(uint16_t width, uint16_t height)
+{
+    if ((uint32_t)width * height > _capacity)
+        return;
+
+    _width = width;
+    _height = height;
+    _pixelCount = width * height;
+
+    for (uint8_t i = 0; i < COMPOSITOR_LAYERS; i++)
+    {
+        _layers[i].index = 0;
+    }
+
+    _dirty = true;
+}
+
+void Compositor::setOverlayEffect(LightEffect effect)
+{
+    EffectLayer *overlay = &_layers[overlayLayer];
+
+    if (overlay->effect == effect)
+        return;
+
+    overlay->effect = effect;
+    overlay->cycle = 0;
+    overlay->index = 0;
+    _particles.clear(overlayLayer);
+
+    // particles are light, they brighten the base instead of covering it
+    overlay->blendMode = isParticleEffect(effect) ? BlendMode::blendAdd : BlendMode::blendKeyed;
+
+    _dirty = true;
+}
+
+LightEffect Compositor::getBaseEffect()
+{
+    return _layers[baseLayer].effect;
+}
+
+LightEffect Compositor::getOverlayEffect()
+{
+    return _layers[overlayLayer].effect;
+}
+
+void Compositor::invalidate()
+{
+    _dirty = true;
+}
+
+bool Compositor::isDirty()
+{
+    return _dirty;
+}
+
+bool Compositor::isAnimated()
+{
+    if (_crossfading)
+        return true;
+
+    for (uint8_t i = 0; i < COMPOSITOR_LAYERS; i++)
+    {
+        LightEffect effect = _layers[i].effect;
+
+        if (effect != LightEffect::unknown && effect != LightEffect::solid)
+            return true;
+    }
+
+    return false;
+}
+
+bool Compositor::render(unsigned long now, uint32_t color)
+{
+    if (_frame == nullptr)
+        return false;
+
+    if (!_dirty && !isAnimated())
+        return false;
+
+    _dirty = false;
+
+    if (_crossfading)
+    {
+        unsigned long elapsed = now - _crossfadeStart;
+
+        if (elapsed >= _crossfadeMillis)
+        {
+            _crossfading = false;
+            _layers[fadingLayer].effect = LightEffect::unknown;
+            _particles.clear(fadingLayer);
+            _layers[baseLayer].alpha = 256;
+        }
+        else
+        {
+            _layers[baseLayer].alpha = (elapsed * 256) / _crossfadeMillis;
+        }
+    }
+
+    EffectLayer *active[COMPOSITOR_LAYERS];
+    uint8_t activeCount = 0;
+
+    for (uint8_t i = 0; i < COMPOSITOR_LAYERS; i++)
+    {
+        EffectLayer *layer = &_layers[i];
+
+        if (layer->effect == LightEffect::unknown)
+            continue;
+
+        renderLayer(layer, color);
+        active[activeCount++] = layer;
+    }
+
+    // a single pass over the frame combines every active layer, bottom to top
+    for (uint16_t p = 0; p < _pixelCount; p++)
+    {
+        uint32_t pixel = 0;
+
+        for (uint8_t i = 0; i < activeCount; i++)
+        {
+            pixel = blend(pixel, active[i]->pixels[p], active[i]->blendMode, active[i]->alpha);
+        }
+
+        _frame[p] = pixel;
+    }
+
+    return true;
+}
+
+const uint32_t *Compositor::getFrame()
+{
+    return _frame;
+}
+
+uint16_t Compositor::getPixelCount()
+{
+    return _pixelCount;
+}
+
+void Compositor::renderLayer(EffectLayer *layer, uint32_t color)
+{
+    uint32_t *pixels = layer->pixels;
+
+    switch (layer->effect)
+    {
+    case LightEffect::solid:
+        for (uint16_t i = 0; i < _pixelCount; i++)
+        {
+            pixels[i] = color;
+        }
+        break;
+    case LightEffect::rainbow:
+        // diagonal bands on a matrix, a plain rainbow on a strip
+        for (uint16_t y = 0; y < _height; y++)
+        {
+            uint32_t *row = &pixels[y * _width];
+
+            for (uint16_t x = 0; x < _width; x++)
+            {
+                row[x] = LedUtils::ColorFromWheel((x + y + layer->cycle) & 255);
+            }
+        }
+
+        layer->cycle = (layer->cycle + 1) & 255;
+        break;
+    case LightEffect::dot:
+        memset(pixels, 0, _pixelCount * sizeof(uint32_t));
+        pixels[layer->index] = color;
+
+        layer->index++;
+        if (layer->index >= _pixelCount)
+            layer->index = 0;
+        break;
+    case LightEffect::transition:
+        // a snapshot of an interrupted crossfade, the pixels stay as they are
+        break;
+    case LightEffect::lava:
+    case LightEffect::ocean:
+    case LightEffect::aurora:
+    case LightEffect::plasma:
+        renderNoise(layer);
+        break;
+    case LightEffect::fire:
+    case LightEffect::sparkle:
+    case LightEffect::meteor:
+    case LightEffect::confetti:
+    {
+        uint8_t owner = layer - _layers;
+
+        memset(pixels, 0, _pixelCount * sizeof(uint32_t));
+        _particles.update(owner, _pixelCount);
+        _particles.emit(owner, layer->effect, color, _pixelCount, layer->cycle);
+        _particles.render(owner, pixels, _pixelCount);
+
+        layer->cycle++;
+        break;
+    }
+    default:
+        memset(pixels, 0, _pixelCount * sizeof(uint32_t));
+        break;
+    }
+}
+
+void Compositor::renderNoise(EffectLayer *layer)
+{
+    const uint32_t *palette = nullptr;  // nullptr = the sample is used as hue
+    uint32_t scale;                     // distance between two pixels, in 1/65536 of a noise cell
+    uint8_t speed;                      // shift of the frame counter, at least 8 to wrap without a seam
+    uint8_t octaves;
+
+    switch (layer->effect)
+    {
+    case LightEffect::lava:
+        palette = _lavaPalette;
+        scale = 8192;
+        speed = 9;
+        octaves = 3;
+        break;
+    case LightEffect::ocean:
+        palette = _oceanPalette;
+        scale = 12288;
+        speed = 10;
+        octaves = 2;
+        break;
+    case LightEffect::aurora:
+        palette = _auroraPalette;
+        scale = 4096;
+        speed = 9;
+        octaves = 2;
+        break;
+    default:
+        scale = 6144;
+        speed = 10;
+        octaves = 1;
+        break;
+    }
+
+    uint32_t time = (uint32_t)layer->cycle << speed;
+    uint32_t *pixels = layer->pixels;
+
+    // a strip is a slice through 2D noise (x, time), a matrix through 3D noise (x, y, time)
+    for (uint16_t y = 0; y < _height; y++)
+    {
+        uint32_t *row = &pixels[y * _width];
+
+        for (uint16_t x = 0; x < _width; x++)
+        {
+            uint8_t sample = _height == 1 ? Noise::Fractal2D(x * scale, time, octaves)
+                                          : Noise::Fractal3D(x * scale, y * scale, time, octaves);
+
+            row[x] = palette != nullptr ? LedUtils::ColorFromPalette(palette, sample) : LedUtils::ColorFromWheel(sample);
+        }
+    }
+
+    if (layer->effect == LightEffect::aurora)
+    {
+        // the curtains shimmer along the strip
+        for (uint16_t i = 0; i < _pixelCount; i++)
+        {
+            uint16_t brightness = 129 + (Noise::Sample1D(i * scale * 4 + time * 4) >> 1);
+            pixels[i] = LedUtils::Scale(pixels[i], brightness);
+        }
+    }
+
+    layer->cycle++;
+}
+
+uint32_t Compositor::blend(uint32_t dst, uint32_t src, BlendMode mode, uint16_t alpha)
+{
+    switch (mode)
+    {
+    case BlendMode::blendOpaque:
+        return alpha >= 256 ? src : LedUtils::Blend(src, dst, alpha);
+    case BlendMode::blendKeyed:
+        if (src == 0)
+            return dst;
+
+        return alpha >= 256 ? src : LedUtils::Blend(src, dst, alpha);
+    case BlendMode::blendAdd:
+        return LedUtils::AddSaturate(LedUtils::Scale(src, alpha), dst);
+    }
+
+    return dst;
+}
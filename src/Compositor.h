@@ -0,0 +1,132 @@
+#ifndef __COMPOSITOR_H__
+#define __COMPOSITOR_H__
+
+#include <Arduino.h>
+#include "LightState.h"
+#include "ParticleSystem.h"
+
+#define COMPOSITOR_LAYERS 3
+#define DEFAULT_CROSSFADE_MILLIS 400
+
+enum BlendMode
+{
+    blendOpaque,    // alpha blend, every pixel covers the layers below
+    blendKeyed,     // alpha blend, black pixels are transparent
+    blendAdd        // saturating add
+};
+
+/**
+ * @brief One effect rendering into its own pixel buffer
+ */
+struct EffectLayer
+{
+    LightEffect effect = LightEffect::unknown;     // unknown = inactive
+    BlendMode blendMode = BlendMode::blendOpaque;
+    uint16_t alpha = 256;                          // 0-256
+    uint16_t cycle = 0;                            // animation step
+    uint16_t index = 0;                            // position of moving effects
+    uint32_t *pixels = nullptr;
+};
+
+/**
+ * @brief Renders the effect layers into separate buffers and blends them into one frame.
+ *
+ * Layer 0 holds the outgoing effect of a crossfade, layer 1 the base effect and
+ * layer 2 an optional overlay (e.g. a dot chasing over a solid background).
+ * When a crossfade is interrupted, layer 0 holds a snapshot of it (LightEffect::transition).
+ * The buffers and the particle pool are taken from the boot arena, so the frame costs no heap.
+ */
+class Compositor
+{
+private:
+    uint16_t _capacity = 0;
+    uint16_t _pixelCount = 0;
+    uint16_t _width = 0;
+    uint16_t _height = 1;
+    EffectLayer _layers[COMPOSITOR_LAYERS];
+    ParticleSystem _particles;
+    uint32_t *_frame = nullptr;
+    unsigned long _crossfadeStart = 0;
+    uint16_t _crossfadeMillis = 0;
+    bool _crossfading = false;
+    volatile bool _dirty = true;
+
+    void renderLayer(EffectLayer *layer, uint32_t color);
+    void renderNoise(EffectLayer *layer);
+
+public:
+    static const uint8_t fadingLayer = 0;
+    static const uint8_t baseLayer = 1;
+    static const uint8_t overlayLayer = 2;
+
+    /**
+     * @brief Allocate the layer and frame buffers, must be called during setup
+     *
+     * @param pixelCount The number of pixels of every buffer
+     * @return true The buffers could be allocated
+     */
+    bool setup(uint16_t pixelCount);
+
+    /**
+     * @brief Change the base effect, the previous one fades out over the given time
+     *
+     * @param effect The new effect
+     * @param crossfadeMillis The duration of the crossfade, 0 switches immediately
+     * @param now The current millis()
+     */
+    void setBaseEffect(LightEffect effect, uint16_t crossfadeMillis, unsigned long now);
+
+    /**
+     * @brief Render in layout space, the frame gets width * height pixels (index = y * width + x)
+     *
+     * @param width The logical width
+     * @param height The logical height
+     */
+    void setDimensions(uint16_t width, uint16_t height);
+
+    /**
+     * @brief Set the effect rendered on top of the base effect
+     *
+     * @param effect The overlay effect, LightEffect::unknown removes the overlay
+     */
+    void setOverlayEffect(LightEffect effect);
+
+    LightEffect getBaseEffect();
+    LightEffect getOverlayEffect();
+
+    /**
+     * @brief Force the next render to produce a frame, e.g. because the color changed
+     */
+    void invalidate();
+    bool isDirty();
+
+    /**
+     * @brief Whether the next frames would differ from the current one
+     */
+    bool isAnimated();
+
+    /**
+     * @brief Render every active layer into its buffer, then blend them into the frame in one pass
+     *
+     * @param now The current millis()
+     * @param color The color of the light state
+     * @return true The frame changed and has to be shown
+     */
+    bool render(unsigned long now, uint32_t color);
+
+    const uint32_t *getFrame();
+    uint16_t getPixelCount();
+
+    /**
+     * @brief Combine one pixel of a layer with the pixel below it
+     *
+     * @param dst The pixel of the layers below
+     * @param src The pixel of the layer
+     * @param mode How to combine the pixels
+     * @param alpha The opacity of the layer, 0-256
+     * @return uint32_t The combined pixel
+     */
+    static uint32_t blend(uint32_t dst, uint32_t src, BlendMode mode, uint16_t alpha);
+};
+
+#endif // __COMPOSITOR_H__
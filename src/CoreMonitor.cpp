@@ -0,0 +1,131 @@
+#include "CoreMonitor.h"
+#include "Logger.h"
+#include "esp_freertos_hooks.h"
+#include <algorithm>
+
+uint8_t CoreMonitor::_load[portNUM_PROCESSORS] = {0};
+
+#if CORE_MONITOR_RUN_TIME_STATS
+
+uint32_t CoreMonitor::_sampledIdleTime[portNUM_PROCESSORS] = {0};
+uint32_t CoreMonitor::_sampledTime = 0;
+
+uint32_t CoreMonitor::idleRunTime(uint8_t core)
+{
+    TaskStatus_t status;
+
+    // passing a state skips the lookup of the actual one, only the counter is needed
+    vTaskGetInfo(xTaskGetIdleTaskHandleForCPU(core), &status, pdFALSE, eReady);
+
+    return status.ulRunTimeCounter;
+}
+
+void CoreMonitor::setup()
+{
+    _sampledTime = portGET_RUN_TIME_COUNTER_VALUE();
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        _sampledIdleTime[core] = idleRunTime(core);
+    }
+
+    LOG_INFO("render on core %u, network on core %u", RENDER_CORE, NETWORK_CORE);
+}
+
+void CoreMonitor::sample()
+{
+    uint32_t now = portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t elapsed = now - _sampledTime;
+
+    if (elapsed == 0)
+        return;
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        uint32_t idleTime = idleRunTime(core);
+        uint32_t idle = std::min(idleTime - _sampledIdleTime[core], elapsed);
+
+        _load[core] = 100 - (uint64_t)idle * 100 / elapsed;
+        _sampledIdleTime[core] = idleTime;
+    }
+
+    _sampledTime = now;
+}
+
+#else
+
+volatile uint32_t CoreMonitor::_idleTicks[portNUM_PROCESSORS] = {0};
+volatile TickType_t CoreMonitor::_lastIdleTick[portNUM_PROCESSORS] = {0};
+uint32_t CoreMonitor::_sampledIdleTicks[portNUM_PROCESSORS] = {0};
+TickType_t CoreMonitor::_sampledTick = 0;
+
+bool CoreMonitor::idleHook()
+{
+    // each hook only touches the counters of its own core
+    uint8_t core = xPortGetCoreID();
+    TickType_t tick = xTaskGetTickCount();
+
+    if (tick != _lastIdleTick[core])
+    {
+        _lastIdleTick[core] = tick;
+        _idleTicks[core]++;
+    }
+
+    // true lets the core sleep until the next interrupt
+    return true;
+}
+
+void CoreMonitor::setup()
+{
+    _sampledTick = xTaskGetTickCount();
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        if (esp_register_freertos_idle_hook_for_cpu(idleHook, core) != ESP_OK)
+            LOG_WARN("idle hook of core %u could not be registered", core);
+    }
+
+    LOG_WARN("no FreeRTOS run time statistics, the core load is estimated per tick");
+    LOG_INFO("render on core %u, network on core %u", RENDER_CORE, NETWORK_CORE);
+}
+
+void CoreMonitor::sample()
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t elapsed = now - _sampledTick;
+
+    if (elapsed == 0)
+        return;
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        uint32_t idleTicks = _idleTicks[core];
+        uint32_t idle = std::min(idleTicks - _sampledIdleTicks[core], elapsed);
+
+        _load[core] = 100 - (idle * 100) / elapsed;
+        _sampledIdleTicks[core] = idleTicks;
+    }
+
+    _sampledTick = now;
+}
+
+#endif
+
+uint8_t CoreMonitor::getLoad(uint8_t core)
+{
+    return core < portNUM_PROCESSORS ? _load[core] : 0;
+}
+
+void CoreMonitor::report(Print &out)
+{
+    out.printf("{\"cores\":%u,\"render_core\":%u,\"network_core\":%u,\"load_source\":\"%s\",\"load_pct\":[",
+               (unsigned)portNUM_PROCESSORS, (unsigned)RENDER_CORE, (unsigned)NETWORK_CORE,
+               CORE_MONITOR_RUN_TIME_STATS ? "run_time" : "ticks");
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        out.printf("%s%u", core == 0 ? "" : ",", (unsigned)_load[core]);
+    }
+
+    out.print("]}");
+}
@@ -0,0 +1,74 @@
+#ifndef __COREMONITOR_H__
+#define __COREMONITOR_H__
+
+#include <Arduino.h>
+
+// the core of the network task (MQTT publishing, WebSocket housekeeping), the render loop
+// keeps running on the core of the Arduino loop task (ARDUINO_RUNNING_CORE)
+#ifndef NETWORK_CORE
+#define NETWORK_CORE 0
+#endif
+
+#ifndef ARDUINO_RUNNING_CORE
+#define ARDUINO_RUNNING_CORE 0
+#endif
+
+#define RENDER_CORE ARDUINO_RUNNING_CORE
+
+#if defined(configGENERATE_RUN_TIME_STATS) && defined(configUSE_TRACE_FACILITY)
+#define CORE_MONITOR_RUN_TIME_STATS (configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY)
+#else
+#define CORE_MONITOR_RUN_TIME_STATS 0
+#endif
+
+/**
+ * @brief Measures the load of every core from the time its idle task ran.
+ *
+ * With the FreeRTOS run time statistics (configGENERATE_RUN_TIME_STATS, microseconds from
+ * esp_timer) the run time counter of each idle task is read, the rest of the elapsed time
+ * is the load of the core. Without them an idle hook per core marks every tick in which the
+ * idle task got to run, a coarse estimate with a resolution of one tick.
+ */
+class CoreMonitor
+{
+private:
+#if CORE_MONITOR_RUN_TIME_STATS
+    static uint32_t _sampledIdleTime[portNUM_PROCESSORS];
+    static uint32_t _sampledTime;
+
+    static uint32_t idleRunTime(uint8_t core);
+#else
+    static volatile uint32_t _idleTicks[portNUM_PROCESSORS];
+    static volatile TickType_t _lastIdleTick[portNUM_PROCESSORS];
+    static uint32_t _sampledIdleTicks[portNUM_PROCESSORS];
+    static TickType_t _sampledTick;
+
+    static bool idleHook();
+#endif
+    static uint8_t _load[portNUM_PROCESSORS];
+
+public:
+    /**
+     * @brief Start the measurement (register the idle hooks), has to be called during setup
+     */
+    static void setup();
+
+    /**
+     * @brief Compute the load since the last sample, called periodically (e.g. once per second)
+     */
+    static void sample();
+
+    /**
+     * @brief The load of a core in percent, as of the last sample
+     */
+    static uint8_t getLoad(uint8_t core);
+
+    /**
+     * @brief Write the core assignment and the load of every core as JSON
+     *
+     * @param out The target to print to
+     */
+    static void report(Print &out);
+};
+
+#endif // __COREMONITOR_H__
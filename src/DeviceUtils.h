@@ -3,6 +3,15 @@
 
 #include <Arduino.h>
 #include "Preferences.h"
+#include "MemoryBudget.h"
+
+#define DEVICE_ID_LENGTH 16
+#define TOPIC_PREFIX "homeassistant/light/"
+#define TOPIC_LONGEST_SUFFIX "/latency"
+
+// sized from the parts, the compiler can prove that no topic gets truncated
+#define BASE_TOPIC_LENGTH (sizeof(TOPIC_PREFIX) - 1 + DEVICE_ID_LENGTH)
+#define TOPIC_LENGTH (BASE_TOPIC_LENGTH + sizeof(TOPIC_LONGEST_SUFFIX) - 1)
 
 /**
  * @brief Utility methods for device specific function
@@ -11,6 +20,13 @@ class DeviceUtils
 {
 private:
     Preferences * _preferences;
+    char _deviceId[DEVICE_ID_LENGTH] = {0};
+    char _baseTopic[BASE_TOPIC_LENGTH] = {0};
+    char _stateTopic[TOPIC_LENGTH] = {0};
+    char _commandTopic[TOPIC_LENGTH] = {0};
+    char _discoveryTopic[TOPIC_LENGTH] = {0};
+    char _presetTopic[TOPIC_LENGTH] = {0};
+    char _latencyTopic[TOPIC_LENGTH] = {0};
 public:
 
     DeviceUtils(Preferences* preferences)
@@ -30,48 +46,71 @@ public:
         esp_efuse_mac_get_default(mac_base);
         esp_read_mac(mac_base, ESP_MAC_WIFI_STA);
 
-        // format the mac address in HEX
-        char macAddress[6];
-        sprintf(macAddress, "%02X%02X%02X", mac_base[3], mac_base[4], mac_base[5]);
+        // compose the device name, based on the last 3 bytes of the mac address in HEX
+        char deviceId[DEVICE_ID_LENGTH];
+        snprintf(deviceId, sizeof(deviceId), "LEDCont%02X%02X%02X", mac_base[3], mac_base[4], mac_base[5]);
 
-        // compose the device name
-        String deviceIdString = "LEDCont";
-        deviceIdString += macAddress[0];
-        deviceIdString += macAddress[1];
-        deviceIdString += macAddress[2];
-        deviceIdString += macAddress[3];
-        deviceIdString += macAddress[4];
-        deviceIdString += macAddress[5];
+        return String(deviceId);
+    }
 
-        return deviceIdString;
+    /**
+     * @brief Read the device id from the preferences and compose every topic once,
+     * later lookups are served from these buffers without touching the heap
+     */
+    void Init()
+    {
+        String deviceId = _preferences->getString(PREF_DEVICE_NAME_KEY);
+        strlcpy(_deviceId, deviceId.c_str(), sizeof(_deviceId));
+
+        snprintf(_baseTopic, sizeof(_baseTopic), TOPIC_PREFIX "%s", _deviceId);
+        snprintf(_stateTopic, sizeof(_stateTopic), "%s/state", _baseTopic);
+        snprintf(_commandTopic, sizeof(_commandTopic), "%s/set", _baseTopic);
+        snprintf(_discoveryTopic, sizeof(_discoveryTopic), "%s/config", _baseTopic);
+        snprintf(_presetTopic, sizeof(_presetTopic), "%s/preset", _baseTopic);
+        snprintf(_latencyTopic, sizeof(_latencyTopic), "%s" TOPIC_LONGEST_SUFFIX, _baseTopic);
+
+        MemoryBudget::reserve(MemorySubsystem::topicStrings, DEVICE_ID_LENGTH + BASE_TOPIC_LENGTH + 5 * TOPIC_LENGTH);
     }
 
-    String GetDeviceId()
+    const char* GetDeviceId()
     {
-        return _preferences->getString(PREF_DEVICE_NAME_KEY);
+        return _deviceId;
     }
 
-    String GetBaseTopic()
+    const char* GetBaseTopic()
     {
-        auto topic = String("homeassistant/light/");
-        topic += GetDeviceId();
+        return _baseTopic;
+    }
 
-        return topic;
+    const char* GetStateTopic()
+    {
+        return _stateTopic;
+    }
+
+    const char* GetCommandTopic()
+    {
+        return _commandTopic;
     }
 
-    String GetStateTopic()
+    const char* GetHomeAssistantDiscoveryTopic()
     {
-        return GetBaseTopic() + "/state";
+        return _discoveryTopic;
     }
 
-    String GetCommandTopic()
+    /**
+     * @brief The topic to recall presets, the payload is just the preset id
+     */
+    const char* GetPresetTopic()
     {
-        return GetBaseTopic() + "/set";
+        return _presetTopic;
     }
 
-    String GetHomeAssistantDiscoveryTopic()
+    /**
+     * @brief The topic the command latency percentiles are published to
+     */
+    const char* GetLatencyTopic()
     {
-        return GetBaseTopic() + "/config";
+        return _latencyTopic;
     }
 };
 
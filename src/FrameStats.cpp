@@ -0,0 +1,31 @@
+#include "FrameStats.h"
+#include <algorithm>
+
+void FrameStats::record(uint32_t latenessMicros)
+{
+    // a frame that starts a whole interval late has lost its slot
+    if (latenessMicros >= FRAME_INTERVAL_MILLIS * 1000)
+        _missed++;
+
+    _lateness[_next] = latenessMicros;
+    _next = (_next + 1) % FRAME_STATS_WINDOW;
+    _count++;
+}
+
+void FrameStats::report(Print &out)
+{
+    // the window is copied, the render task may record while a report is written
+    uint32_t sorted[FRAME_STATS_WINDOW];
+    size_t count = std::min<uint32_t>(_count, FRAME_STATS_WINDOW);
+
+    memcpy(sorted, _lateness, count * sizeof(uint32_t));
+    std::sort(sorted, sorted + count);
+
+    uint32_t p50 = count > 0 ? sorted[(count - 1) * 50 / 100] : 0;
+    uint32_t p99 = count > 0 ? sorted[(count - 1) * 99 / 100] : 0;
+    uint32_t max = count > 0 ? sorted[count - 1] : 0;
+
+    out.printf("{\"interval_ms\":%u,\"frames\":%u,\"missed\":%u,\"late_us\":{\"p50\":%u,\"p99\":%u,\"max\":%u}}",
+               (unsigned)FRAME_INTERVAL_MILLIS, (unsigned)_count, (unsigned)_missed,
+               (unsigned)p50, (unsigned)p99, (unsigned)max);
+}
@@ -0,0 +1,39 @@
+#ifndef __FRAMESTATS_H__
+#define __FRAMESTATS_H__
+
+#include <Arduino.h>
+
+// the render loop aims for one frame every 20 ms (50 fps) while animating
+#define FRAME_INTERVAL_MILLIS 20
+
+// number of recent frames the percentiles are computed from
+#define FRAME_STATS_WINDOW 64
+
+/**
+ * @brief Tracks how late the frames of a running animation start compared to their deadline
+ */
+class FrameStats
+{
+private:
+    uint32_t _lateness[FRAME_STATS_WINDOW];
+    uint16_t _next = 0;
+    uint32_t _count = 0;
+    uint32_t _missed = 0;
+
+public:
+    /**
+     * @brief Account one frame
+     *
+     * @param latenessMicros The time between the deadline and the start of the frame
+     */
+    void record(uint32_t latenessMicros);
+
+    /**
+     * @brief Write the frame count, the missed deadlines and the lateness percentiles as JSON
+     *
+     * @param out The target to print to
+     */
+    void report(Print &out);
+};
+
+#endif // __FRAMESTATS_H__
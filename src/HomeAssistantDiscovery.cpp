@@ -0,0 +1,155 @@
+#include "HomeAssistantDiscovery.h"
+#include "LedUtils.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+#include <algorithm>
+
+/**
+ * @brief Only counts the bytes, used to size the payload buffer
+ */
+class CountingPrint : public Print
+{
+public:
+    size_t count = 0;
+
+    size_t write(uint8_t c) override
+    {
+        count++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        count += size;
+        return size;
+    }
+};
+
+/**
+ * @brief Prints into a fixed buffer, everything beyond its end is cut off
+ */
+class BufferPrint : public Print
+{
+private:
+    char *_buffer;
+    size_t _size;
+
+public:
+    size_t length = 0;
+
+    BufferPrint(char *buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t count = std::min(size, _size - length);
+        memcpy(_buffer + length, buffer, count);
+        length += count;
+
+        return count;
+    }
+};
+
+bool HomeAssistantDiscovery::addLight(const char *discoveryTopic, const char *baseTopic, const char *uniqueId, const char *name)
+{
+    if (_count >= DISCOVERY_MAX_ENTITIES || _buffer != nullptr)
+        return false;
+
+    _entities[_count] = {.discoveryTopic = discoveryTopic, .baseTopic = baseTopic, .uniqueId = uniqueId, .name = name};
+    _count++;
+    _next = _count;
+
+    return true;
+}
+
+bool HomeAssistantDiscovery::setup(const char *deviceId)
+{
+    _deviceId = deviceId;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        _bufferSize = std::max(_bufferSize, measure(i));
+    }
+
+    _buffer = static_cast<char *>(MemoryBudget::allocate(MemorySubsystem::mqttBuffers, _bufferSize));
+
+    if (_buffer == nullptr)
+    {
+        LOG_ERROR("discovery buffer could not be allocated");
+        return false;
+    }
+
+    return true;
+}
+
+void HomeAssistantDiscovery::restart()
+{
+    _next = 0;
+}
+
+bool HomeAssistantDiscovery::isPending()
+{
+    return _next < _count && _buffer != nullptr;
+}
+
+bool HomeAssistantDiscovery::publishNext(AsyncMqttClient *client)
+{
+    if (!isPending())
+        return true;
+
+    const DiscoveryEntity *entity = &_entities[_next];
+
+    BufferPrint out(_buffer, _bufferSize);
+    writeLight(out, entity);
+
+    // the client copies the payload, the buffer is free again afterwards
+    if (client->publish(entity->discoveryTopic, 0, false, _buffer, out.length) == 0)
+        return false;
+
+    LOG_DEBUG(LOG_MQTT, "discovery for '%s' published, %u bytes", entity->uniqueId, out.length);
+    _next++;
+
+    return true;
+}
+
+size_t HomeAssistantDiscovery::measure(uint8_t index)
+{
+    CountingPrint out;
+    writeLight(out, &_entities[index]);
+
+    return out.count;
+}
+
+void HomeAssistantDiscovery::writeLight(Print &out, const DiscoveryEntity *entity)
+{
+    // the ids and topics are built from the MAC address and effect names are plain words,
+    // nothing needs to be escaped
+    out.print("{\"~\":\"");
+    out.print(entity->baseTopic);
+    out.print("\",\"name\":\"");
+    out.print(entity->name);
+    out.print("\",\"unique_id\":\"");
+    out.print(entity->uniqueId);
+    out.print("\",\"cmd_t\":\"~/set\",\"stat_t\":\"~/state\",\"schema\":\"json\",\"color_mode\":true,\"brightness\":true,"
+              "\"supported_color_modes\":[\"rgbw\"],\"effect\":true,\"effect_list\":[");
+
+    // every selectable effect, a new one shows up without touching the discovery
+    bool first = true;
+    for (uint8_t effect = LightEffect::solid; effect < LightEffect::effectCount; effect++)
+    {
+        out.print(first ? "\"" : ",\"");
+        out.print(LedUtils::EffectNameFromEnum(static_cast<LightEffect>(effect)));
+        out.print("\"");
+        first = false;
+    }
+
+    out.print("],\"dev\":{\"ids\":[\"");
+    out.print(_deviceId);
+    out.print("\"],\"name\":\"");
+    out.print(_deviceId);
+    out.print("\"}}");
+}
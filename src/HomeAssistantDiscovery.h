@@ -0,0 +1,75 @@
+#ifndef __HOMEASSISTANTDISCOVERY_H__
+#define __HOMEASSISTANTDISCOVERY_H__
+
+#include <Arduino.h>
+#include "AsyncMqttClient.h"
+
+#define DISCOVERY_MAX_ENTITIES 4
+
+/**
+ * @brief A light entity announced to Home Assistant, one per strip (or segment)
+ */
+struct DiscoveryEntity
+{
+    const char *discoveryTopic;
+    const char *baseTopic;      // the state and command topics are below this one
+    const char *uniqueId;
+    const char *name;
+};
+
+/**
+ * @brief Streams the Home Assistant discovery config of every entity straight into a payload buffer.
+ *
+ * There is no intermediate JSON document: the config is printed piece by piece, once at boot
+ * to measure the largest payload (the buffer is taken from the boot arena in exactly that size)
+ * and then on every connect into that buffer. The entities are published one per call, so a
+ * (re)connect never stalls the caller.
+ */
+class HomeAssistantDiscovery
+{
+private:
+    DiscoveryEntity _entities[DISCOVERY_MAX_ENTITIES];
+    uint8_t _count = 0;
+    uint8_t _next = 0;
+    const char *_deviceId = nullptr;
+    char *_buffer = nullptr;
+    size_t _bufferSize = 0;
+
+    void writeLight(Print &out, const DiscoveryEntity *entity);
+
+public:
+    /**
+     * @brief Register a light entity, only possible before setup
+     *
+     * @return false There is no space for another entity
+     */
+    bool addLight(const char *discoveryTopic, const char *baseTopic, const char *uniqueId, const char *name);
+
+    /**
+     * @brief Measure the payloads and allocate the buffer for the largest one
+     *
+     * @param deviceId The device every entity belongs to
+     */
+    bool setup(const char *deviceId);
+
+    /**
+     * @brief Announce every entity again, e.g. after the broker connection was (re)established
+     */
+    void restart();
+
+    bool isPending();
+
+    /**
+     * @brief Publish the config of the next pending entity
+     *
+     * @return false The client could not take the message, it is tried again with the next call
+     */
+    bool publishNext(AsyncMqttClient *client);
+
+    /**
+     * @brief The size of the config of an entity, without the terminating zero
+     */
+    size_t measure(uint8_t index);
+};
+
+#endif // __HOMEASSISTANTDISCOVERY_H__
@@ -0,0 +1,85 @@
+#include "LatencyTracer.h"
+#include <algorithm>
+
+void LatencyTracer::record(const CommandTrace *trace)
+{
+    uint16_t slot = _next;
+
+    _samples[TraceStage::stageParse][slot] = trace->parsedMicros - trace->receivedMicros;
+    _samples[TraceStage::stageApply][slot] = trace->appliedMicros - trace->parsedMicros;
+    _samples[TraceStage::stageQueue][slot] = trace->frameMicros - trace->appliedMicros;
+    _samples[TraceStage::stageRender][slot] = trace->showStartMicros - trace->frameMicros;
+    _samples[TraceStage::stageShow][slot] = trace->shownMicros - trace->showStartMicros;
+    _samples[TraceStage::stageTotal][slot] = trace->shownMicros - trace->receivedMicros;
+
+    _next = (slot + 1) % TRACE_WINDOW;
+    _count++;
+}
+
+uint32_t LatencyTracer::getCount()
+{
+    return _count;
+}
+
+void LatencyTracer::percentiles(TraceStage stage, uint32_t *p50, uint32_t *p90, uint32_t *p99, uint32_t *max)
+{
+    // the window is copied, the render task may record while a report is written
+    uint32_t sorted[TRACE_WINDOW];
+    size_t count = std::min<uint32_t>(_count, TRACE_WINDOW);
+
+    memcpy(sorted, _samples[stage], count * sizeof(uint32_t));
+    std::sort(sorted, sorted + count);
+
+    if (count == 0)
+    {
+        *p50 = *p90 = *p99 = *max = 0;
+        return;
+    }
+
+    *p50 = sorted[(count - 1) * 50 / 100];
+    *p90 = sorted[(count - 1) * 90 / 100];
+    *p99 = sorted[(count - 1) * 99 / 100];
+    *max = sorted[count - 1];
+}
+
+size_t LatencyTracer::toJson(char *buffer, size_t size)
+{
+    size_t length = snprintf(buffer, size, "{\"count\":%u,\"window\":%u,\"stages_us\":{",
+                             (unsigned)_count, (unsigned)std::min<uint32_t>(_count, TRACE_WINDOW));
+
+    for (uint8_t i = 0; i < TraceStage::stageCount && length < size; i++)
+    {
+        uint32_t p50, p90, p99, max;
+        percentiles(static_cast<TraceStage>(i), &p50, &p90, &p99, &max);
+
+        length += snprintf(buffer + length, size - length, "%s\"%s\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}",
+                           i == 0 ? "" : ",", StageName(static_cast<TraceStage>(i)),
+                           (unsigned)p50, (unsigned)p90, (unsigned)p99, (unsigned)max);
+    }
+
+    if (length < size)
+        length += snprintf(buffer + length, size - length, "}}");
+
+    return std::min(length, size - 1);
+}
+
+const char *LatencyTracer::StageName(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TraceStage::stageParse:
+        return "parse";
+    case TraceStage::stageApply:
+        return "apply";
+    case TraceStage::stageQueue:
+        return "queue";
+    case TraceStage::stageRender:
+        return "render";
+    case TraceStage::stageShow:
+        return "show";
+    case TraceStage::stageTotal:
+        return "total";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef __LATENCYTRACER_H__
+#define __LATENCYTRACER_H__
+
+#include <Arduino.h>
+
+// number of recent commands the percentiles are computed from
+#define TRACE_WINDOW 64
+
+enum TraceStage
+{
+    stageParse,     // received -> parsed
+    stageApply,     // parsed -> applied to the controller state
+    stageQueue,     // applied -> picked up by a frame
+    stageRender,    // frame start -> show() starts
+    stageShow,      // show() starts -> show() returned
+    stageTotal,     // received -> show() returned
+    stageCount
+};
+
+/**
+ * @brief Microsecond timestamps of one command, carried from the transport to show()
+ */
+struct CommandTrace
+{
+    uint32_t receivedMicros = 0;
+    uint32_t parsedMicros = 0;
+    uint32_t appliedMicros = 0;
+    uint32_t frameMicros = 0;
+    uint32_t showStartMicros = 0;
+    uint32_t shownMicros = 0;
+};
+
+/**
+ * @brief Keeps the stage latencies of the most recent commands and computes their percentiles
+ */
+class LatencyTracer
+{
+private:
+    uint32_t _samples[TraceStage::stageCount][TRACE_WINDOW];
+    uint16_t _next = 0;
+    uint32_t _count = 0;
+
+    void percentiles(TraceStage stage, uint32_t *p50, uint32_t *p90, uint32_t *p99, uint32_t *max);
+
+public:
+    /**
+     * @brief Store the stage latencies of a completed trace
+     */
+    void record(const CommandTrace *trace);
+
+    /**
+     * @brief The number of traced commands since boot
+     */
+    uint32_t getCount();
+
+    /**
+     * @brief Write the percentiles of every stage as JSON
+     *
+     * @param buffer The target buffer
+     * @param size The size of the buffer
+     * @return size_t The length of the JSON
+     */
+    size_t toJson(char *buffer, size_t size);
+
+    static const char *StageName(TraceStage stage);
+};
+
+#endif // __LATENCYTRACER_H__
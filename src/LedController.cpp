@@ -1,53 +1,172 @@
 #include "LedController.h"
 #include "LedUtils.h"
+#include "MemoryBudget.h"
+#include "PresetStore.h"
+#include "Logger.h"
 
 LedController::LedController(Preferences *preferences) : _onboardLed(1, ONBOARD_LED_PIN, NEO_GRB + NEO_KHZ800),
-                                                         _externalLed(EXTERNAL_LED_LENGTH, EXTERNAL_LED_PIN, NEO_GRBW + NEO_KHZ800)
+                                                         _neoPixelDriver(EXTERNAL_LED_PIN),
+                                                         _apa102Driver(EXTERNAL_LED_PIN, EXTERNAL_LED_CLOCK_PIN)
 {
     _preferences = preferences;
+    _requestedState = _state;
 }
 
+/**
+ * @brief Copy the fields an update carries into a state, without touching the strips
+ */
+static void mergeUpdate(LightState *state, const LightStateUpdate *stateUpdate)
+{
+    if (stateUpdate->brightnessPresent)
+        state->brightness = stateUpdate->brightness;
+
+    if (stateUpdate->redPresent || stateUpdate->greenPresent || stateUpdate->bluePresent || stateUpdate->whitePresent)
+    {
+        state->red = stateUpdate->red;
+        state->green = stateUpdate->green;
+        state->blue = stateUpdate->blue;
+        state->white = stateUpdate->white;
+    }
+
+    state->transitionMillis = stateUpdate->transitionPresent ? stateUpdate->transitionMillis : DEFAULT_CROSSFADE_MILLIS;
+
+    if (stateUpdate->overlayEffectPresent)
+        state->overlayEffect = stateUpdate->overlayEffect;
+
+    if (stateUpdate->lightEffectPresent)
+        state->lightEffect = stateUpdate->lightEffect;
+
+    if (stateUpdate->lightOnPresent)
+        state->lightOn = stateUpdate->lightOn;
+}
+
+/**
+ * @brief Combine two updates that arrived within the same frame, the newer fields win
+ */
+static void mergeUpdate(LightStateUpdate *pending, const LightStateUpdate *stateUpdate)
+{
+    if (stateUpdate->brightnessPresent)
+    {
+        pending->brightnessPresent = true;
+        pending->brightness = stateUpdate->brightness;
+    }
+
+    if (stateUpdate->redPresent || stateUpdate->greenPresent || stateUpdate->bluePresent || stateUpdate->whitePresent)
+    {
+        pending->redPresent = stateUpdate->redPresent;
+        pending->greenPresent = stateUpdate->greenPresent;
+        pending->bluePresent = stateUpdate->bluePresent;
+        pending->whitePresent = stateUpdate->whitePresent;
+        pending->red = stateUpdate->red;
+        pending->green = stateUpdate->green;
+        pending->blue = stateUpdate->blue;
+        pending->white = stateUpdate->white;
+    }
+
+    pending->transitionPresent = stateUpdate->transitionPresent;
+    pending->transitionMillis = stateUpdate->transitionMillis;
+
+    if (stateUpdate->overlayEffectPresent)
+    {
+        pending->overlayEffectPresent = true;
+        pending->overlayEffect = stateUpdate->overlayEffect;
+    }
+
+    if (stateUpdate->lightEffectPresent)
+    {
+        pending->lightEffectPresent = true;
+        pending->lightEffect = stateUpdate->lightEffect;
+    }
+
+    if (stateUpdate->lightOnPresent)
+    {
+        pending->lightOnPresent = true;
+        pending->lightOn = stateUpdate->lightOn;
+    }
+}
+
+/**
+ * @brief Queue a state update, it is applied by the render task before its next frame
+ *
+ * Commands arrive on the network tasks (AsyncTCP, the network task), the render task is the only one
+ * that changes the state the frames are built from.
+ *
+ * @param stateUpdate The fields of the command
+ */
 void LedController::setState(LightStateUpdate stateUpdate)
 {
-    Serial.println(F("\nLed controller state will be updated"));
+    LOG_DEBUG(LOG_LIGHT, "led controller state will be updated");
+
+    portENTER_CRITICAL(&_pendingLock);
+    if (_updatePending)
+        mergeUpdate(&_pendingUpdate, &stateUpdate);
+    else
+        _pendingUpdate = stateUpdate;
+
+    _updatePending = true;
+    mergeUpdate(&_requestedState, &stateUpdate);
+    portEXIT_CRITICAL(&_pendingLock);
+
+    // the render task sleeps while the output is static, it must see the new state when it wakes up
+    wake();
+}
+
+/**
+ * @brief Get the state including every queued update, for the state reports and the presets
+ *
+ * @return LightState A copy, the render task may change the state at any time
+ */
+LightState LedController::getState()
+{
+    portENTER_CRITICAL(&_pendingLock);
+    LightState state = _requestedState;
+    portEXIT_CRITICAL(&_pendingLock);
+
+    return state;
+}
 
-    if (stateUpdate.brightnessPresent)
+/**
+ * @brief Apply an update to the state the frames are built from, only called by the render task
+ */
+void LedController::applyState(const LightStateUpdate *stateUpdate)
+{
+    if (stateUpdate->brightnessPresent)
     {
-#if DEBUG_LIGHT
-        Serial.println(F("There is brightness information"));
-#endif
-        _state.brightness = stateUpdate.brightness;
+        LOG_DEBUG(LOG_LIGHT, "There is brightness information");
+        _state.brightness = stateUpdate->brightness;
         setBrightness(_state.brightness);
     }
 
-    if (stateUpdate.redPresent || stateUpdate.greenPresent || stateUpdate.bluePresent || stateUpdate.whitePresent)
+    if (stateUpdate->redPresent || stateUpdate->greenPresent || stateUpdate->bluePresent || stateUpdate->whitePresent)
     {
-#if DEBUG_LIGHT
-        Serial.println(F("There is some color information"));
-#endif
-        _state.red = stateUpdate.red;
-        _state.green = stateUpdate.green;
-        _state.blue = stateUpdate.blue;
-        _state.white = stateUpdate.white;
+        LOG_DEBUG(LOG_LIGHT, "There is some color information");
+        _state.red = stateUpdate->red;
+        _state.green = stateUpdate->green;
+        _state.blue = stateUpdate->blue;
+        _state.white = stateUpdate->white;
 
         uint32_t color = Adafruit_NeoPixel::Color(_state.red, _state.green, _state.blue, _state.white);
         setColor(color);
     }
 
-    if (stateUpdate.lightEffectPresent)
+    _state.transitionMillis = stateUpdate->transitionPresent ? stateUpdate->transitionMillis : DEFAULT_CROSSFADE_MILLIS;
+
+    if (stateUpdate->overlayEffectPresent)
+    {
+        LOG_DEBUG(LOG_LIGHT, "There is overlay effect information");
+        setOverlayEffect(stateUpdate->overlayEffect);
+    }
+
+    if (stateUpdate->lightEffectPresent)
     {
-#if DEBUG_LIGHT
-        Serial.println(F("There is light effect information"));
-#endif
-        setLightEffect(stateUpdate.lightEffect);
+        LOG_DEBUG(LOG_LIGHT, "There is light effect information");
+        setLightEffect(stateUpdate->lightEffect);
     }
 
-    if (stateUpdate.lightOnPresent)
+    if (stateUpdate->lightOnPresent)
     {
-#if DEBUG_LIGHT
-        Serial.println(F("There is state information"));
-#endif
-        _state.lightOn = stateUpdate.lightOn;
+        LOG_DEBUG(LOG_LIGHT, "There is state information");
+        _state.lightOn = stateUpdate->lightOn;
 
         if (_state.lightOn && !_lastState.lightOn)
         {
@@ -60,36 +179,182 @@ void LedController::setState(LightStateUpdate stateUpdate)
     }
 }
 
-const LightState *LedController::getState()
+/**
+ * @brief Attach the trace of an applied command, the next show() of the external strip completes it
+ *
+ * @param trace The trace with the received, parsed and applied timestamps
+ */
+void LedController::traceCommand(const CommandTrace *trace)
 {
-    return &_state;
+    portENTER_CRITICAL(&_pendingLock);
+    _pendingTrace = *trace;
+    _tracePending = true;
+    portEXIT_CRITICAL(&_pendingLock);
 }
 
-void LedController::setBrightness(uint8_t newBrightness)
+LatencyTracer *LedController::getLatencyTracer()
 {
-#if DEBUG_LIGHT
-    Serial.printf("Brightness: %d\n", _state.brightness);
-#endif
-    _onboardLed.setBrightness(_state.brightness);
-    _externalLed.setBrightness(_state.brightness);
+    return &_latencyTracer;
 }
 
-void LedController::setColor(uint32_t newColor)
+/**
+ * @brief Queue a preset, it gets applied at the beginning of the next frame
+ *
+ * The fields are copied right away, a later save() or remove() of the slot does not change the queued state.
+ *
+ * @param preset The preset from the RAM cache of the PresetStore
+ */
+void LedController::recallPreset(const LightPreset *preset)
 {
-#if DEBUG_LIGHT
-    Serial.printf("R: %d; G: %d, B: %d, W: %d\n", _state.red, _state.green, _state.blue, _state.white);
-#endif
+    LightStateUpdate stateUpdate = LightStateUpdate();
+    stateUpdate.lightOnPresent = true;
+    stateUpdate.lightOn = preset->lightOn;
+    stateUpdate.redPresent = true;
+    stateUpdate.red = preset->red;
+    stateUpdate.greenPresent = true;
+    stateUpdate.green = preset->green;
+    stateUpdate.bluePresent = true;
+    stateUpdate.blue = preset->blue;
+    stateUpdate.whitePresent = true;
+    stateUpdate.white = preset->white;
+    stateUpdate.brightnessPresent = true;
+    stateUpdate.brightness = preset->brightness;
+    stateUpdate.lightEffectPresent = true;
+    stateUpdate.lightEffect = preset->lightEffect;
+    stateUpdate.overlayEffectPresent = true;
+    stateUpdate.overlayEffect = preset->overlayEffect;
+
+    setState(stateUpdate);
+}
 
-    _onboardLed.setPixelColor(0, LedUtils::Color(&_state));
+/**
+ * @brief Whether a state update (or a preset) still waits for the render task
+ */
+bool LedController::hasPendingState()
+{
+    return _updatePending;
+}
 
-    _onboardLed.show();
+/**
+ * @brief Get the time the render task may sleep, a state change wakes it up earlier
+ *
+ * @return uint32_t The milliseconds until the next frame is due, UINT32_MAX while the output is static
+ */
+uint32_t LedController::getFrameDelay()
+{
+    if (!needsFrame())
+        return UINT32_MAX;
 
-    for (size_t i = 0; i < EXTERNAL_LED_LENGTH; i++)
-    {
-        _externalLed.setPixelColor(i, LedUtils::Color(&_state));
-    }
+    unsigned long now = millis();
+
+    if (now >= nextRenderExecution)
+        return 0;
+
+    return nextRenderExecution - now;
+}
+
+FrameStats *LedController::getFrameStats()
+{
+    return &_frameStats;
+}
+
+PowerManager *LedController::getPowerManager()
+{
+    return &_powerManager;
+}
+
+LedLayout *LedController::getLayout()
+{
+    return &_layout;
+}
+
+LedDriver *LedController::getExternalDriver()
+{
+    return _externalLed;
+}
+
+uint32_t LedController::getShowMicros()
+{
+    return _showMicros;
+}
+
+/**
+ * @brief Queue a new layout, the table gets rebuilt by the render task before the next frame
+ *
+ * @param config The layout, it has to be valid (LedLayout::isValid)
+ */
+void LedController::setLayout(const LayoutConfig *config)
+{
+    portENTER_CRITICAL(&_pendingLock);
+    _pendingLayout = *config;
+    _layoutPending = true;
+    portEXIT_CRITICAL(&_pendingLock);
+
+    wake();
+}
+
+bool LedController::needsFrame()
+{
+    if (_updatePending || _layoutPending || _compositor.isDirty())
+        return true;
+
+    if (!_state.lightOn)
+        return _outputOn;
+
+    return !_outputOn ||
+           _compositor.isAnimated() ||
+           _state.lightEffect != _compositor.getBaseEffect() ||
+           _state.overlayEffect != _compositor.getOverlayEffect();
+}
+
+void LedController::wake()
+{
+    if (_renderTask != nullptr)
+        xTaskNotifyGive(_renderTask);
+}
+
+void LedController::showExternal()
+{
+    uint32_t showStartMicros = micros();
+    _externalLed->show();
+    uint32_t shownMicros = micros();
+    _shownThisFrame = true;
+
+    // moving average over ~16 frames
+    _showMicros = _showMicros == 0 ? shownMicros - showStartMicros : (_showMicros * 15 + (shownMicros - showStartMicros)) / 16;
+
+    CommandTrace trace;
+    bool tracePending;
+
+    portENTER_CRITICAL(&_pendingLock);
+    tracePending = _tracePending;
+    trace = _pendingTrace;
+    _tracePending = false;
+    portEXIT_CRITICAL(&_pendingLock);
+
+    if (!tracePending)
+        return;
 
-    _externalLed.show();
+    // a command applied while this frame was already running is picked up at the time it was applied
+    trace.frameMicros = (int32_t)(_frameStartMicros - trace.appliedMicros) > 0 ? _frameStartMicros : trace.appliedMicros;
+    trace.showStartMicros = showStartMicros;
+    trace.shownMicros = shownMicros;
+
+    _latencyTracer.record(&trace);
+}
+
+void LedController::setBrightness(uint8_t newBrightness)
+{
+    LOG_DEBUG(LOG_LIGHT, "Brightness: %d", _state.brightness);
+    // applied to the strips by the next frame
+    _compositor.invalidate();
+}
+
+void LedController::setColor(uint32_t newColor)
+{
+    LOG_DEBUG(LOG_LIGHT, "R: %d; G: %d, B: %d, W: %d", _state.red, _state.green, _state.blue, _state.white);
+
+    _compositor.invalidate();
 }
 
 void LedController::setLightEffect(LightEffect newEffect)
@@ -97,57 +362,70 @@ void LedController::setLightEffect(LightEffect newEffect)
     if (_state.lightEffect == newEffect)
         return; // The effect did not change
 
-#if DEBUG_LIGHT
-    Serial.printf("light effect changed to: '%s'\n", LedUtils::EffectNameFromEnum(newEffect));
-#endif
+    LOG_DEBUG(LOG_LIGHT, "light effect changed to: '%s'", LedUtils::EffectNameFromEnum(newEffect));
 
+    // the compositor picks up the change (and starts the crossfade) with the next frame
     _state.lightEffect = newEffect;
     _state.lightEffectChanged = true;
 }
 
-void LedController::setOff()
+void LedController::setOverlayEffect(LightEffect newEffect)
 {
-#if DEBUG_LIGHT
-    Serial.println(F("light turned off"));
-#endif
+    if (_state.overlayEffect == newEffect)
+        return;
 
-    // light switched off
-    _onboardLed.setPixelColor(0, 0, 0, 0, 0);
-    _onboardLed.show();
+    LOG_DEBUG(LOG_LIGHT, "overlay effect changed to: '%s'", LedUtils::EffectNameFromEnum(newEffect));
 
-    for (size_t i = 0; i < EXTERNAL_LED_LENGTH; i++)
-    {
-        _externalLed.setPixelColor(i, 0, 0, 0, 0);
-    }
-
-    _externalLed.show();
+    _state.overlayEffect = newEffect;
 }
 
-void LedController::setOn()
+void LedController::setOff()
 {
-#if DEBUG_LIGHT
-    Serial.println(F("light turned on"));
-#endif
+    LOG_DEBUG(LOG_LIGHT, "light turned off");
 
-    _onboardLed.setPixelColor(0, _state.red, _state.green, _state.blue, _state.white);
-    _onboardLed.show();
+    // the next frame clears the strips
+    _compositor.invalidate();
+}
 
-    for (size_t i = 0; i < EXTERNAL_LED_LENGTH; i++)
-    {
-        _externalLed.setPixelColor(i, LedUtils::Color(&_state));
-    }
+void LedController::setOn()
+{
+    LOG_DEBUG(LOG_LIGHT, "light turned on");
 
-    _externalLed.show();
+    _compositor.invalidate();
 }
 
 void LedController::setup()
 {
+    LedChipset chipset = static_cast<LedChipset>(_preferences->getUChar(PREF_LED_CHIPSET_KEY, EXTERNAL_LED_CHIPSET));
+
+    if (chipset == LedChipset::apa102 || chipset == LedChipset::sk9822)
+        _externalLed = &_apa102Driver;
+    else
+        _externalLed = &_neoPixelDriver;
+
+    if (!_externalLed->begin(chipset, pixelNumber))
+    {
+        LOG_WARN("chipset %u is not supported, falling back to '%s'", chipset, LedDriver::ChipsetName(LedChipset::sk6812));
+        _externalLed = &_neoPixelDriver;
+        _externalLed->begin(LedChipset::sk6812, pixelNumber);
+    }
+
     _onboardLed.setBrightness(_state.brightness);
-    _externalLed.setBrightness(_state.brightness);
+    _externalLed->setBrightness(_state.brightness);
     _onboardLed.begin();
-    _externalLed.begin();
 
-    setLightEffect(LightEffect::solid);
+    // the pixel buffer of the onboard LED is allocated by Adafruit_NeoPixel during static initialization
+    MemoryBudget::reserve(MemorySubsystem::ledBuffers, _onboardLed.numPixels() * 3);
+
+    _compositor.setup(pixelNumber);
+    _compositor.setBaseEffect(_state.lightEffect, 0, millis());
+
+    _layout.setup(_preferences, pixelNumber);
+    _compositor.setDimensions(_layout.getWidth(), _layout.getHeight());
+
+    // setup() runs on the task that renders later on
+    _renderTask = xTaskGetCurrentTaskHandle();
+    _powerManager.setup();
 }
 
 void LedController::loop()
@@ -157,125 +435,120 @@ void LedController::loop()
     if (now < nextRenderExecution)
         return;
 
-    nextRenderExecution = now + 20;
+    nextRenderExecution = now + FRAME_INTERVAL_MILLIS;
 
-    if (_state.lightOn)
+    MemoryBudget::HotPathScope hotPath;
+    _shownThisFrame = false;
+    unsigned long frameStartMicros = micros();
+    _frameStartMicros = frameStartMicros;
+
+    // only the frames of a running animation have a deadline, after a pause a new schedule starts
+    if (_powerManager.getActivity() == RenderActivity::activityAnimated)
+        _frameStats.record((int32_t)(frameStartMicros - _frameDueMicros) > 0 ? frameStartMicros - _frameDueMicros : 0);
+
+    _frameDueMicros = frameStartMicros + FRAME_INTERVAL_MILLIS * 1000;
+
+    if (_layoutPending)
     {
-        switch (_state.lightEffect)
-        {
-        case LightEffect::solid:
-            renderSolid();
-            break;
-        case LightEffect::rainbow:
-            renderRainbow();
-            break;
-        default:
-            break;
-        }
+        LayoutConfig layout;
+
+        portENTER_CRITICAL(&_pendingLock);
+        layout = _pendingLayout;
+        _layoutPending = false;
+        portEXIT_CRITICAL(&_pendingLock);
+
+        _layout.configure(&layout);
+        _compositor.setDimensions(_layout.getWidth(), _layout.getHeight());
+
+        // LEDs outside of the new layout stay dark
+        _externalLed->clear();
     }
 
-    // save the state for the next frame (edge detection)
-    _lastState = _state;
-}
+    if (_updatePending)
+    {
+        LightStateUpdate stateUpdate;
 
-void LedController::renderSolid()
-{
-    if (_state.lightEffectChanged)
+        portENTER_CRITICAL(&_pendingLock);
+        stateUpdate = _pendingUpdate;
+        _updatePending = false;
+        portEXIT_CRITICAL(&_pendingLock);
+
+        applyState(&stateUpdate);
+    }
+
+    if (_state.lightOn)
     {
-        _onboardLed.setPixelColor(0, _state.red, _state.green, _state.blue, _state.white);
-        _onboardLed.show();
+        // every change of the layers happens here, on the render side
+        _compositor.setBaseEffect(_state.lightEffect, _state.transitionMillis, now);
+        _compositor.setOverlayEffect(_state.overlayEffect);
 
-        for (size_t i = 0; i < EXTERNAL_LED_LENGTH; i++)
+        if (!_outputOn || _state.lightEffectChanged)
         {
-            _externalLed.setPixelColor(i, _state.red, _state.green, _state.blue, _state.white);
+            _state.lightEffectChanged = false;
+            _compositor.invalidate();
         }
-        _externalLed.show();
 
-        _state.lightEffectChanged = false;
+        if (_compositor.render(now, LedUtils::Color(&_state)))
+        {
+            showFrame();
+        }
+    }
+    else if (_outputOn)
+    {
+        clearOutput();
     }
-}
 
-void LedController::renderRainbow()
-{
-    _state.lightEffectChanged = false;
+    // a command that arrived before this frame and did not lead to a visible change is not measured
+    portENTER_CRITICAL(&_pendingLock);
+    if (!_shownThisFrame && _tracePending && (int32_t)(frameStartMicros - _pendingTrace.appliedMicros) > 0)
+        _tracePending = false;
+    portEXIT_CRITICAL(&_pendingLock);
 
-    _onboardLed.setPixelColor(0, LedUtils::ColorFromWheel((0 + pixelCycle) & 255));
-    _onboardLed.show();
+    // save the state for the next frame (edge detection)
+    _lastState = _state;
 
-    for (uint16_t i = 0; i < pixelNumber; i++)
-    {
-        //_externalLed.setPixelColor(i, Adafruit_NeoPixel::ColorHSV((i + pixelCycle) & 255));
-        _externalLed.setPixelColor(i, LedUtils::ColorFromWheel((i + pixelCycle) & 255)); //  Update delay time
-    }
+    unsigned long frameEndMicros = micros();
+    _powerManager.addBusyTime(frameEndMicros - frameStartMicros);
 
-    _externalLed.show(); //  Update strip to match
-    pixelCycle++;        //  Advance current cycle
+    RenderActivity activity = RenderActivity::activityOff;
+    if (_state.lightOn)
+        activity = _compositor.isAnimated() ? RenderActivity::activityAnimated : RenderActivity::activityStatic;
 
-    if (pixelCycle >= 256)
-        pixelCycle = 0; //  Loop the cycle back to the begining
+    _powerManager.setActivity(activity, frameEndMicros);
 }
 
-void LedController::renderDot(unsigned long now, bool reverse)
+void LedController::showFrame()
 {
-    static bool up = true;
-    static size_t index = 0;
+    const uint32_t *frame = _compositor.getFrame();
 
-    // turn any led of at the beginning
-    if (_state.lightEffectChanged)
+    if (_externalLed->getBrightness() != _state.brightness)
     {
-        _state.lightEffectChanged = false;
-
-        for (size_t i = 0; i < EXTERNAL_LED_LENGTH; i++)
-        {
-            _externalLed.setPixelColor(i, 0);
-        }
-
-        up = true;
-        index = 0;
+        _onboardLed.setBrightness(_state.brightness);
+        _externalLed->setBrightness(_state.brightness);
     }
 
-    if (now >= nextExecution)
+    const uint16_t *map = _layout.getMap();
+    uint16_t count = _compositor.getPixelCount();
+
+    // the frame is in layout space, one table lookup per pixel puts it on the strip
+    for (uint16_t i = 0; i < count; i++)
     {
-        nextExecution = now + 1;
+        _externalLed->setPixel(map[i], frame[i]);
+    }
 
-        _externalLed.setPixelColor(index, LedUtils::Color(&_state));
-        _externalLed.show();
-        // turn it off
-        _externalLed.setPixelColor(index, 0);
+    _onboardLed.setPixelColor(0, frame[0]);
+    _onboardLed.show();
 
-        if (up)
-        {
-            if (index < (EXTERNAL_LED_LENGTH - 1))
-            {
-                index++;
-            }
-            else
-            {
-                if (reverse)
-                {
-                    up = false;
-                }
-                else
-                {
-                    index = 0;
-                }
-            }
-        }
-        else
-        {
-            if (index > 0)
-            {
-                index--;
-            }
-            else
-            {
-                up = true;
-            }
-        }
-    }
+    showExternal();
+    _outputOn = true;
 }
 
-void LedController::renderDotTrace(unsigned long now, bool reverse)
+void LedController::clearOutput()
 {
-    renderDot(now, reverse);
+    _onboardLed.clear();
+    _onboardLed.show();
+
+    _externalLed->clear();
+    showExternal();
+    _outputOn = false;
 }
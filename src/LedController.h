@@ -4,6 +4,14 @@
 #include "Preferences.h"
 #include "Adafruit_NeoPixel.h"
 #include "ArduinoJson.h"
+#include "LightState.h"
+#include "Compositor.h"
+#include "PowerManager.h"
+#include "LatencyTracer.h"
+#include "LedLayout.h"
+#include "NeoPixelDriver.h"
+#include "Apa102Driver.h"
+#include "FrameStats.h"
 
 #define JSON_STATE_KEY "state"
 #define JSON_BRIGHTNESS_KEY "brightness"
@@ -14,94 +22,101 @@
 #define JSON_BLUE_KEY "b"
 #define JSON_WHITE_KEY "w"
 #define JSON_EFFECT_KEY "effect"
+#define JSON_OVERLAY_KEY "overlay"
+#define JSON_TRANSITION_KEY "transition"
 
+#ifndef ONBOARD_LED_PIN
 #if ESP32S2 == 0
 #define ONBOARD_LED_PIN 8
 #else
 #define ONBOARD_LED_PIN 18
 #endif
+#endif
 
-
-
+#ifndef EXTERNAL_LED_PIN
 #define EXTERNAL_LED_PIN 1
+#endif
 #define EXTERNAL_LED_LENGTH 150
 
-enum LightEffect 
-{
-    unknown,
-    transition,
-    solid,
-    rainbow
-};
+// only used by the clocked (SPI) chipsets
+#ifndef EXTERNAL_LED_CLOCK_PIN
+#define EXTERNAL_LED_CLOCK_PIN 2
+#endif
 
-struct LightStateUpdate
-{
-    bool lightOnPresent = false;;
-    bool lightOn = false;
-    bool redPresent = false;
-    byte red = 0;
-    bool greenPresent = false;
-    byte green = 0;
-    bool bluePresent = false;
-    byte blue = 0;
-    bool whitePresent = false;
-    byte white = 0;
-    bool brightnessPresent = false;
-    byte brightness = 0;
-    bool lightEffectPresent = false;
-    LightEffect lightEffect = LightEffect::unknown;
-};
+// the chipset until another one is selected at runtime
+#ifndef EXTERNAL_LED_CHIPSET
+#define EXTERNAL_LED_CHIPSET LedChipset::sk6812
+#endif
 
-struct LightState 
-{
-    bool lightOn;
-    byte red;
-    byte green;
-    byte blue;
-    byte white;
-    byte brightness;
-    LightEffect lightEffect;
-    bool lightEffectChanged;
-};
+#define PREF_LED_CHIPSET_KEY "ledChipset"
 
+struct LightPreset;
 
 class LedController
 {
 private:
     Preferences* _preferences;
     LightState _lastState;
-    LightState _state = { .lightOn = false, .red = 0, .green = 0, .blue = 0, .white = 255, .brightness = 120, .lightEffect = LightEffect::solid };
+    LightState _state = { .lightOn = false, .red = 0, .green = 0, .blue = 0, .white = 255, .brightness = 120, .lightEffect = LightEffect::solid, .lightEffectChanged = false, .overlayEffect = LightEffect::unknown, .transitionMillis = DEFAULT_CROSSFADE_MILLIS };
 
     Adafruit_NeoPixel _onboardLed;
-    Adafruit_NeoPixel _externalLed;
+    NeoPixelDriver _neoPixelDriver;
+    Apa102Driver _apa102Driver;
+    LedDriver* _externalLed = nullptr;
+    uint32_t _showMicros = 0;               // moving average of the external show()
+    Compositor _compositor;
+    LedLayout _layout;
+    LayoutConfig _pendingLayout;
+    volatile bool _layoutPending = false;
+    bool _outputOn = false;                 // whether the strips show anything right now
+    PowerManager _powerManager;
+    TaskHandle_t _renderTask = nullptr;
 
     unsigned long nextRenderExecution = 0;
-    unsigned long nextExecution = 0;
-    unsigned long pixelPrevious = 0;        // Previous Pixel Millis
-    unsigned long patternPrevious = 0;      // Previous Pattern Millis
-    int           patternCurrent = 0;       // Current Pattern Number
-    int           patternInterval = 5000;   // Pattern Interval (ms)
-    int           pixelInterval = 50;       // Pixel Interval (ms)
-    int           pixelQueue = 0;           // Pattern Pixel Queue
-    int           pixelCycle = 0;           // Pattern Pixel Cycle
-    uint16_t      pixelCurrent = 0;         // Pattern Current Pixel Number
     uint16_t      pixelNumber = EXTERNAL_LED_LENGTH;  // Total Number of Pixels
 
+    portMUX_TYPE _pendingLock = portMUX_INITIALIZER_UNLOCKED;
+    CommandTrace _pendingTrace;
+    bool _tracePending = false;             // a command waits for the strip
+    unsigned long _frameStartMicros = 0;
+    bool _shownThisFrame = false;
+    LatencyTracer _latencyTracer;
+    FrameStats _frameStats;
+    unsigned long _frameDueMicros = 0;
+    LightStateUpdate _pendingUpdate;
+    volatile bool _updatePending = false;
+    LightState _requestedState;             // the state with every queued update, read by the network side
+
+    void showExternal();
+    bool needsFrame();
+    void wake();
+    void showFrame();
+    void clearOutput();
+    void applyState(const LightStateUpdate* stateUpdate);
+
 public:
     LedController(Preferences* preferences);
     void setState(LightStateUpdate stateUpdate);
-    const LightState* getState();
+    LightState getState();
+    void traceCommand(const CommandTrace* trace);
+    LatencyTracer* getLatencyTracer();
+    void recallPreset(const LightPreset* preset);
+    bool hasPendingState();
+    uint32_t getFrameDelay();
+    FrameStats* getFrameStats();
+    PowerManager* getPowerManager();
+    LedLayout* getLayout();
+    LedDriver* getExternalDriver();
+    uint32_t getShowMicros();
+    void setLayout(const LayoutConfig* config);
     void setBrightness(uint8_t newBrightness);
     void setColor(uint32_t newColor);
     void setLightEffect(LightEffect newEffect);
     void setOff();
     void setOn();
     void setup();
+    void setOverlayEffect(LightEffect newEffect);
     void loop();
-    void renderSolid();
-    void renderRainbow();
-    void renderDot(unsigned long now, bool reverse);
-    void renderDotTrace(unsigned long now, bool reverse);
 };
 
 #endif // __LEDCONTROLLER_H__
\ No newline at end of file
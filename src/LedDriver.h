@@ -0,0 +1,89 @@
+#ifndef __LEDDRIVER_H__
+#define __LEDDRIVER_H__
+
+#include <Arduino.h>
+
+enum LedChipset
+{
+    ws2812,     // single wire 800 kHz, RGB
+    sk6812,     // single wire 800 kHz, RGBW
+    apa102,     // clocked SPI, RGB + 5 bit global brightness per pixel
+    sk9822,     // clocked SPI, APA102 compatible with a different end frame
+    chipsetCount
+};
+
+/**
+ * @brief The wire protocol of the external strip, LedController only talks to this interface
+ */
+class LedDriver
+{
+public:
+    virtual ~LedDriver() {}
+
+    /**
+     * @brief Allocate the buffers and set up the peripheral, has to be called during setup
+     *
+     * @param chipset The chipset of the strip
+     * @param pixelCount The number of LEDs
+     * @return true The driver supports the chipset and is ready
+     */
+    virtual bool begin(LedChipset chipset, uint16_t pixelCount) = 0;
+
+    /**
+     * @brief Set a pixel, the color is a packed WRGB value (Adafruit_NeoPixel::Color)
+     */
+    virtual void setPixel(uint16_t index, uint32_t color) = 0;
+
+    virtual void setBrightness(uint8_t brightness) = 0;
+    virtual uint8_t getBrightness() = 0;
+    virtual void clear() = 0;
+
+    /**
+     * @brief Transfer the pixels to the strip
+     */
+    virtual void show() = 0;
+
+    virtual uint16_t numPixels() = 0;
+
+    /**
+     * @brief The number of bytes one frame puts on the wire
+     */
+    virtual size_t frameBytes() = 0;
+
+    /**
+     * @brief The theoretical duration of one frame on the wire, including the latch
+     */
+    virtual uint32_t wireMicros() = 0;
+
+    virtual LedChipset chipset() = 0;
+
+    static const char *ChipsetName(LedChipset chipset)
+    {
+        switch (chipset)
+        {
+        case LedChipset::ws2812:
+            return "ws2812";
+        case LedChipset::sk6812:
+            return "sk6812";
+        case LedChipset::apa102:
+            return "apa102";
+        case LedChipset::sk9822:
+            return "sk9822";
+        default:
+            return "unknown";
+        }
+    }
+
+    static LedChipset ChipsetFromName(const char *name)
+    {
+        for (uint8_t i = 0; i < LedChipset::chipsetCount; i++)
+        {
+            if (strcmp(name, ChipsetName(static_cast<LedChipset>(i))) == 0)
+                return static_cast<LedChipset>(i);
+        }
+
+        return LedChipset::chipsetCount;
+    }
+};
+
+#endif // __LEDDRIVER_H__
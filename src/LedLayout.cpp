@@ -0,0 +1,288 @@
+#include "LedLayout.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+
+bool LedLayout::setup(Preferences *preferences, uint16_t pixelCount)
+{
+    _preferences = preferences;
+    _pixelCount = pixelCount;
+
+    _map = static_cast<uint16_t *>(MemoryBudget::allocate(MemorySubsystem::layoutTables, pixelCount * sizeof(uint16_t)));
+    _customMap = static_cast<uint16_t *>(MemoryBudget::allocate(MemorySubsystem::layoutTables, pixelCount * sizeof(uint16_t)));
+    _stagedMap = static_cast<uint16_t *>(MemoryBudget::allocate(MemorySubsystem::layoutTables, pixelCount * sizeof(uint16_t)));
+
+    if (_map == nullptr || _customMap == nullptr || _stagedMap == nullptr)
+    {
+        LOG_ERROR("layout tables could not be allocated");
+        return false;
+    }
+
+    // a plain strip until something else is configured
+    LayoutConfig config = {.width = pixelCount, .height = 1, .rotation = 0, .serpentine = false, .mirrorX = false, .mirrorY = false, .custom = false};
+
+    for (uint16_t i = 0; i < pixelCount; i++)
+    {
+        _customMap[i] = i;
+    }
+
+    LayoutConfig stored;
+
+    if (load(&stored))
+    {
+        if (_preferences->getBytesLength(PREF_LAYOUT_MAP_KEY) == pixelCount * sizeof(uint16_t))
+            _preferences->getBytes(PREF_LAYOUT_MAP_KEY, _customMap, pixelCount * sizeof(uint16_t));
+
+        if (isValid(&stored))
+            config = stored;
+    }
+
+    configure(&config);
+
+    return true;
+}
+
+/**
+ * @brief Read the layout in the current format
+ *
+ * @return true The record exists and has the current version
+ */
+bool LedLayout::load(LayoutConfig *config)
+{
+    uint8_t record[LAYOUT_RECORD_SIZE];
+
+    if (_preferences->getBytesLength(PREF_LAYOUT_KEY) != sizeof(record))
+        return false;
+
+    _preferences->getBytes(PREF_LAYOUT_KEY, record, sizeof(record));
+
+    if (record[0] != LAYOUT_FORMAT_VERSION)
+    {
+        LOG_WARN("layout format %u is not supported, using a plain strip", record[0]);
+        return false;
+    }
+
+    config->width = record[1] | (record[2] << 8);
+    config->height = record[3] | (record[4] << 8);
+    config->rotation = record[5] | (record[6] << 8);
+    config->serpentine = record[7] != 0;
+    config->mirrorX = record[8] != 0;
+    config->mirrorY = record[9] != 0;
+    config->custom = record[10] != 0;
+
+    return true;
+}
+
+bool LedLayout::isValid(const LayoutConfig *config)
+{
+    if (config->width == 0 || config->height == 0)
+        return false;
+
+    if ((uint32_t)config->width * config->height > _pixelCount)
+        return false;
+
+    return config->rotation == 0 || config->rotation == 90 || config->rotation == 180 || config->rotation == 270;
+}
+
+void LedLayout::configure(const LayoutConfig *config)
+{
+    if (_map == nullptr || !isValid(config))
+        return;
+
+    _config = *config;
+
+    if (_stagedReady)
+    {
+        // a completed upload, nobody writes the staging table until the owner is released
+        uint16_t *customMap = _customMap;
+        _customMap = _stagedMap;
+        _stagedMap = customMap;
+        _stagedReady = false;
+        _stagingOwner = nullptr;
+    }
+
+    bool swapped = _config.rotation == 90 || _config.rotation == 270;
+    _width = swapped ? _config.height : _config.width;
+    _height = swapped ? _config.width : _config.height;
+
+    uint16_t count = getCount();
+
+    if (_config.custom)
+    {
+        memcpy(_map, _customMap, count * sizeof(uint16_t));
+        return;
+    }
+
+    for (uint16_t y = 0; y < _height; y++)
+    {
+        for (uint16_t x = 0; x < _width; x++)
+        {
+            _map[y * _width + x] = physicalIndex(x, y);
+        }
+    }
+}
+
+uint16_t LedLayout::physicalIndex(uint16_t x, uint16_t y)
+{
+    uint16_t width = _config.width;
+    uint16_t height = _config.height;
+
+    if (_config.mirrorX)
+        x = _width - 1 - x;
+    if (_config.mirrorY)
+        y = _height - 1 - y;
+
+    uint16_t px;
+    uint16_t py;
+
+    switch (_config.rotation)
+    {
+    case 90:
+        px = y;
+        py = height - 1 - x;
+        break;
+    case 180:
+        px = width - 1 - x;
+        py = height - 1 - y;
+        break;
+    case 270:
+        px = width - 1 - y;
+        py = x;
+        break;
+    default:
+        px = x;
+        py = y;
+        break;
+    }
+
+    if (_config.serpentine && (py & 1))
+        px = width - 1 - px;
+
+    return py * width + px;
+}
+
+bool LedLayout::beginCustomMap(const void *owner)
+{
+    // uploads run on the AsyncTCP task, only configure() on the render task releases the table
+    if (_stagedMap == nullptr || _stagingOwner != nullptr)
+        return false;
+
+    _stagingOwner = owner;
+    _stagedBytes = 0;
+
+    return true;
+}
+
+bool LedLayout::writeCustomMap(const void *owner, const uint8_t *data, size_t index, size_t len)
+{
+    if (_stagingOwner != owner || _stagedReady)
+        return false;
+
+    if (index != _stagedBytes || (len & 1) || index + len > _pixelCount * sizeof(uint16_t))
+    {
+        _stagingOwner = nullptr;
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i += 2)
+    {
+        uint16_t physical = data[i] | (data[i + 1] << 8);
+
+        if (physical >= _pixelCount)
+        {
+            _stagingOwner = nullptr;
+            return false;
+        }
+
+        _stagedMap[(index + i) / 2] = physical;
+    }
+
+    _stagedBytes += len;
+
+    return true;
+}
+
+bool LedLayout::commitCustomMap(const void *owner, const LayoutConfig *config)
+{
+    if (_stagingOwner != owner || _stagedReady)
+        return false;
+
+    if (!isValid(config) || _stagedBytes != (size_t)config->width * config->height * sizeof(uint16_t))
+    {
+        _stagingOwner = nullptr;
+        return false;
+    }
+
+    _preferences->putBytes(PREF_LAYOUT_MAP_KEY, _stagedMap, _pixelCount * sizeof(uint16_t));
+    _stagedReady = true;
+
+    return true;
+}
+
+void LedLayout::abortCustomMap(const void *owner)
+{
+    if (_stagingOwner == owner && !_stagedReady)
+        _stagingOwner = nullptr;
+}
+
+void LedLayout::persist(const LayoutConfig *config)
+{
+    uint8_t record[LAYOUT_RECORD_SIZE];
+
+    record[0] = LAYOUT_FORMAT_VERSION;
+    record[1] = config->width;
+    record[2] = config->width >> 8;
+    record[3] = config->height;
+    record[4] = config->height >> 8;
+    record[5] = config->rotation;
+    record[6] = config->rotation >> 8;
+    record[7] = config->serpentine ? 1 : 0;
+    record[8] = config->mirrorX ? 1 : 0;
+    record[9] = config->mirrorY ? 1 : 0;
+    record[10] = config->custom ? 1 : 0;
+
+    if (_preferences->putBytes(PREF_LAYOUT_KEY, record, sizeof(record)) != sizeof(record))
+    {
+        LOG_ERROR("layout could not be written to flash");
+    }
+}
+
+const LayoutConfig *LedLayout::getConfig()
+{
+    return &_config;
+}
+
+uint16_t LedLayout::getWidth()
+{
+    return _width;
+}
+
+uint16_t LedLayout::getHeight()
+{
+    return _height;
+}
+
+uint16_t LedLayout::getCount()
+{
+    return _width * _height;
+}
+
+const uint16_t *LedLayout::getMap()
+{
+    return _map;
+}
+
+uint16_t LedLayout::indexAt(uint16_t x, uint16_t y)
+{
+    if (x >= _width || y >= _height)
+        return 0;
+
+    return _map[y * _width + x];
+}
+
+uint16_t LedLayout::indexAtNormalized(uint16_t u, uint16_t v)
+{
+    uint16_t x = ((uint32_t)u * _width) >> 16;
+    uint16_t y = ((uint32_t)v * _height) >> 16;
+
+    return indexAt(x, y);
+}
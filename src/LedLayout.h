@@ -0,0 +1,127 @@
+#ifndef __LEDLAYOUT_H__
+#define __LEDLAYOUT_H__
+
+#include <Arduino.h>
+#include "Preferences.h"
+
+#define PREF_LAYOUT_KEY "layout"
+#define PREF_LAYOUT_MAP_KEY "layoutMap"
+
+// the flash format: a version byte, width, height and rotation (16 bit little endian), then the flags
+#define LAYOUT_FORMAT_VERSION 1
+#define LAYOUT_RECORD_SIZE (1 + 3 * 2 + 4)
+
+/**
+ * @brief How the physical LEDs are arranged, width and height describe the wiring
+ */
+struct LayoutConfig
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t rotation;      // 0, 90, 180 or 270 degrees clockwise
+    bool serpentine;        // every second row runs backwards
+    bool mirrorX;
+    bool mirrorY;
+    bool custom;            // use the uploaded table instead of the geometry above
+};
+
+/**
+ * @brief Maps logical coordinates to physical LED indices through a precomputed table.
+ *
+ * Effects render into a logical frame (index = y * width + x), the output is a single
+ * table lookup per pixel, no matter whether the strip is a line, a serpentine matrix or
+ * folded around a fixture with a custom map.
+ */
+class LedLayout
+{
+private:
+    Preferences *_preferences = nullptr;
+    uint16_t _pixelCount = 0;
+    LayoutConfig _config;
+    uint16_t _width = 0;            // logical width (after the rotation)
+    uint16_t _height = 0;
+    uint16_t *_map = nullptr;       // logical index -> physical index
+    uint16_t *_customMap = nullptr; // the uploaded table
+    uint16_t *_stagedMap = nullptr; // an upload in progress, swapped in by configure()
+    size_t _stagedBytes = 0;
+    const void *volatile _stagingOwner = nullptr;
+    volatile bool _stagedReady = false;
+
+    uint16_t physicalIndex(uint16_t x, uint16_t y);
+    bool load(LayoutConfig *config);
+
+public:
+    /**
+     * @brief Allocate the tables and load the layout from the preferences, has to be called during setup
+     *
+     * @param preferences Where the layout is persisted
+     * @param pixelCount The number of physical LEDs
+     * @return true The tables could be allocated
+     */
+    bool setup(Preferences *preferences, uint16_t pixelCount);
+
+    /**
+     * @brief Check a layout before it gets applied
+     */
+    bool isValid(const LayoutConfig *config);
+
+    /**
+     * @brief Rebuild the table for a new layout, only the render task may call this
+     */
+    void configure(const LayoutConfig *config);
+
+    /**
+     * @brief Start the upload of a custom table, there is one staging table, so one upload at a time
+     *
+     * @param owner Identifies the upload (the request), the other calls have to pass the same one
+     * @return true The staging table was free
+     */
+    bool beginCustomMap(const void *owner);
+
+    /**
+     * @brief Stage the next part of an uploaded custom table, the physical indices as 16 bit little endian.
+     * The table in use is not touched, a failed part ends the upload.
+     *
+     * @return true The part follows the previous one, fits and every index is in range
+     */
+    bool writeCustomMap(const void *owner, const uint8_t *data, size_t index, size_t len);
+
+    /**
+     * @brief Finish an upload: store the staged table in flash, the render task swaps it in with the next configure()
+     *
+     * @param config The layout the table is meant for, it has to be valid
+     * @return true Exactly one index per position of the layout was staged
+     */
+    bool commitCustomMap(const void *owner, const LayoutConfig *config);
+
+    /**
+     * @brief Drop an upload that did not complete, a committed one is kept
+     */
+    void abortCustomMap(const void *owner);
+
+    /**
+     * @brief Store the layout in flash, a custom table is stored by commitCustomMap()
+     */
+    void persist(const LayoutConfig *config);
+
+    const LayoutConfig *getConfig();
+    uint16_t getWidth();
+    uint16_t getHeight();
+    uint16_t getCount();
+    const uint16_t *getMap();
+
+    /**
+     * @brief The physical index of a logical coordinate
+     */
+    uint16_t indexAt(uint16_t x, uint16_t y);
+
+    /**
+     * @brief The physical index of a normalized position
+     *
+     * @param u The horizontal position, 0 - 65535 (left to right)
+     * @param v The vertical position, 0 - 65535 (top to bottom)
+     */
+    uint16_t indexAtNormalized(uint16_t u, uint16_t v);
+};
+
+#endif // __LEDLAYOUT_H__
@@ -2,6 +2,7 @@
 #define __LEDUTILS_H__
 
 #include "Adafruit_NeoPixel.h"
+#include "LightState.h"
 
 class LedUtils
 {
@@ -43,6 +44,72 @@ public:
         return Adafruit_NeoPixel::Color(wheelPos * 3, 255 - wheelPos * 3, 0);
     }
 
+    /**
+     * @brief Mix two packed WRGB colors, all four channels are computed at once (two per 32 bit lane pair)
+     * 
+     * @param src The color on top
+     * @param dst The color below
+     * @param alpha The weight of src, 0-256 (256 = only src)
+     * @return uint32_t The mixed color
+     */
+    static inline uint32_t Blend(uint32_t src, uint32_t dst, uint16_t alpha)
+    {
+        uint16_t inverse = 256 - alpha;
+        uint32_t rb = (((src & 0x00FF00FF) * alpha + (dst & 0x00FF00FF) * inverse) >> 8) & 0x00FF00FF;
+        uint32_t wg = (((src >> 8) & 0x00FF00FF) * alpha + ((dst >> 8) & 0x00FF00FF) * inverse) & 0xFF00FF00;
+
+        return rb | wg;
+    }
+
+    /**
+     * @brief Scale every channel of a packed WRGB color
+     * 
+     * @param color The color to scale
+     * @param alpha The factor, 0-256 (256 = unchanged)
+     * @return uint32_t The scaled color
+     */
+    static inline uint32_t Scale(uint32_t color, uint16_t alpha)
+    {
+        uint32_t rb = (((color & 0x00FF00FF) * alpha) >> 8) & 0x00FF00FF;
+        uint32_t wg = (((color >> 8) & 0x00FF00FF) * alpha) & 0xFF00FF00;
+
+        return rb | wg;
+    }
+
+    /**
+     * @brief Add two packed WRGB colors, every channel saturates at 255
+     * 
+     * @return uint32_t The sum of both colors
+     */
+    static inline uint32_t AddSaturate(uint32_t a, uint32_t b)
+    {
+        uint32_t rb = (a & 0x00FF00FF) + (b & 0x00FF00FF);
+        uint32_t wg = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF);
+
+        // a carry into bit 8 of a lane turns the whole lane into 0xFF
+        uint32_t carry = rb & 0x01000100;
+        rb = (rb | (carry - (carry >> 8))) & 0x00FF00FF;
+        carry = wg & 0x01000100;
+        wg = (wg | (carry - (carry >> 8))) & 0x00FF00FF;
+
+        return rb | (wg << 8);
+    }
+
+    /**
+     * @brief Get a color from a gradient of 16 colors, the colors in between are interpolated
+     * 
+     * @param palette 16 packed colors, from index 0 to 255
+     * @param index The position in the gradient 0-255
+     * @return uint32_t The color at the position
+     */
+    static inline uint32_t ColorFromPalette(const uint32_t* palette, uint8_t index)
+    {
+        uint8_t entry = index >> 4;
+        uint8_t next = entry < 15 ? entry + 1 : 15;
+
+        return Blend(palette[next], palette[entry], (index & 15) << 4);
+    }
+
     /**
      * @brief Get the string for a effect
      * 
@@ -59,11 +126,82 @@ public:
         case LightEffect::rainbow:
             return "rainbow";
             break;
+        case LightEffect::dot:
+            return "dot";
+            break;
+        case LightEffect::lava:
+            return "lava";
+            break;
+        case LightEffect::ocean:
+            return "ocean";
+            break;
+        case LightEffect::aurora:
+            return "aurora";
+            break;
+        case LightEffect::plasma:
+            return "plasma";
+            break;
+        case LightEffect::fire:
+            return "fire";
+            break;
+        case LightEffect::sparkle:
+            return "sparkle";
+            break;
+        case LightEffect::meteor:
+            return "meteor";
+            break;
+        case LightEffect::confetti:
+            return "confetti";
+            break;
         default:
             return "unknown";
             break;
         }
     }
+
+    /**
+     * @brief Get the effect for a name, the inverse of EffectNameFromEnum
+     * 
+     * @param name The name of the effect
+     * @return LightEffect The effect or LightEffect::unknown when not supported
+     */
+    static LightEffect EffectFromName(const char* name)
+    {
+        if (strcmp(name, "solid") == 0)
+            return LightEffect::solid;
+
+        if (strcmp(name, "rainbow") == 0)
+            return LightEffect::rainbow;
+
+        if (strcmp(name, "dot") == 0)
+            return LightEffect::dot;
+
+        if (strcmp(name, "lava") == 0)
+            return LightEffect::lava;
+
+        if (strcmp(name, "ocean") == 0)
+            return LightEffect::ocean;
+
+        if (strcmp(name, "aurora") == 0)
+            return LightEffect::aurora;
+
+        if (strcmp(name, "plasma") == 0)
+            return LightEffect::plasma;
+
+        if (strcmp(name, "fire") == 0)
+            return LightEffect::fire;
+
+        if (strcmp(name, "sparkle") == 0)
+            return LightEffect::sparkle;
+
+        if (strcmp(name, "meteor") == 0)
+            return LightEffect::meteor;
+
+        if (strcmp(name, "confetti") == 0)
+            return LightEffect::confetti;
+
+        return LightEffect::unknown;
+    }
 };
 
 #endif // __LEDUTILS_H__
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef __LIGHTSTATE_H__
+#define __LIGHTSTATE_H__
+
+#include <Arduino.h>
+
+enum LightEffect 
+{
+    unknown,
+    transition,
+    solid,
+    rainbow,
+    dot,
+    lava,
+    ocean,
+    aurora,
+    plasma,
+    fire,
+    sparkle,
+    meteor,
+    confetti,
+    effectCount
+};
+
+struct LightStateUpdate
+{
+    bool lightOnPresent = false;
+    bool lightOn = false;
+    bool redPresent = false;
+    byte red = 0;
+    bool greenPresent = false;
+    byte green = 0;
+    bool bluePresent = false;
+    byte blue = 0;
+    bool whitePresent = false;
+    byte white = 0;
+    bool brightnessPresent = false;
+    byte brightness = 0;
+    bool lightEffectPresent = false;
+    LightEffect lightEffect = LightEffect::unknown;
+    bool overlayEffectPresent = false;
+    LightEffect overlayEffect = LightEffect::unknown;
+    bool transitionPresent = false;
+    uint16_t transitionMillis = 0;
+};
+
+struct LightState 
+{
+    bool lightOn;
+    byte red;
+    byte green;
+    byte blue;
+    byte white;
+    byte brightness;
+    LightEffect lightEffect;
+    bool lightEffectChanged;
+    LightEffect overlayEffect;      // unknown when there is no overlay
+    uint16_t transitionMillis;      // crossfade duration for the next effect change
+};
+
+#endif // __LIGHTSTATE_H__
@@ -0,0 +1,143 @@
+#ifndef __LIGHTSTATEJSON_H__
+#define __LIGHTSTATEJSON_H__
+
+#include "ArduinoJson.h"
+#include "LedController.h"
+#include "LedUtils.h"
+#include "Logger.h"
+
+/**
+ * @brief The JSON schema of the light state, shared by every command path (MQTT, HTTP, WebSocket)
+ */
+class LightStateJson
+{
+public:
+    /**
+     * @brief Read a state update from a JSON command
+     *
+     * @param jsonDoc The deserialized command
+     * @param stateUpdate The update to fill, only the present fields will be marked
+     */
+    static void Parse(JsonDocument &jsonDoc, LightStateUpdate *stateUpdate)
+    {
+        if (jsonDoc.containsKey(JSON_STATE_KEY))
+        {
+            LOG_DEBUG(LOG_MQTT, "Message contains state information");
+            stateUpdate->lightOnPresent = true;
+
+            const char *state = jsonDoc[JSON_STATE_KEY] | "";
+            if (strcmp(state, "ON") == 0)
+                stateUpdate->lightOn = true;
+            else if (strcmp(state, "OFF") == 0)
+                stateUpdate->lightOn = false;
+        }
+
+        if (jsonDoc.containsKey(JSON_BRIGHTNESS_KEY))
+        {
+            LOG_DEBUG(LOG_MQTT, "Message contains brightness information");
+            stateUpdate->brightnessPresent = true;
+            stateUpdate->brightness = jsonDoc[JSON_BRIGHTNESS_KEY];
+        }
+
+        if (jsonDoc.containsKey(JSON_COLOR_KEY))
+        {
+            LOG_DEBUG(LOG_MQTT, "Message contains color information");
+            JsonVariant colorVariant = jsonDoc[JSON_COLOR_KEY];
+
+            if (colorVariant.containsKey(JSON_RED_KEY))
+            {
+                stateUpdate->redPresent = true;
+                stateUpdate->red = colorVariant[JSON_RED_KEY];
+            }
+
+            if (colorVariant.containsKey(JSON_GREEN_KEY))
+            {
+                stateUpdate->greenPresent = true;
+                stateUpdate->green = colorVariant[JSON_GREEN_KEY];
+            }
+
+            if (colorVariant.containsKey(JSON_BLUE_KEY))
+            {
+                stateUpdate->bluePresent = true;
+                stateUpdate->blue = colorVariant[JSON_BLUE_KEY];
+            }
+
+            if (colorVariant.containsKey(JSON_WHITE_KEY))
+            {
+                stateUpdate->whitePresent = true;
+                stateUpdate->white = colorVariant[JSON_WHITE_KEY];
+            }
+        }
+
+        if (jsonDoc.containsKey(JSON_EFFECT_KEY))
+        {
+            LOG_DEBUG(LOG_MQTT, "Message contains effect information");
+            const char *effectString = jsonDoc[JSON_EFFECT_KEY] | "";
+
+            stateUpdate->lightEffect = LedUtils::EffectFromName(effectString);
+            stateUpdate->lightEffectPresent = stateUpdate->lightEffect != LightEffect::unknown;
+
+            if (!stateUpdate->lightEffectPresent)
+            {
+                LOG_WARN_TEXT("light effect: '%s' is not supported", effectString);
+            }
+        }
+
+        if (jsonDoc.containsKey(JSON_OVERLAY_KEY))
+        {
+            const char *overlayString = jsonDoc[JSON_OVERLAY_KEY] | "none";
+
+            // "none" removes the overlay
+            stateUpdate->overlayEffect = LedUtils::EffectFromName(overlayString);
+            stateUpdate->overlayEffectPresent = stateUpdate->overlayEffect != LightEffect::unknown || strcmp(overlayString, "none") == 0;
+        }
+
+        if (jsonDoc.containsKey(JSON_TRANSITION_KEY))
+        {
+            // Home Assistant sends the transition in seconds
+            float seconds = jsonDoc[JSON_TRANSITION_KEY] | 0.0f;
+            stateUpdate->transitionPresent = true;
+            stateUpdate->transitionMillis = static_cast<uint16_t>(constrain(seconds, 0.0f, 60.0f) * 1000.0f);
+        }
+    }
+
+    /**
+     * @brief Write the light state in the format Home Assistant expects
+     *
+     * @param state The state to serialize
+     * @param jsonDoc The document to fill, it will be cleared before
+     */
+    static void Serialize(const LightState *state, JsonDocument &jsonDoc)
+    {
+        jsonDoc.clear();
+
+        if (state->lightOn)
+            jsonDoc[JSON_STATE_KEY] = F("ON");
+        else
+            jsonDoc[JSON_STATE_KEY] = F("OFF");
+
+        jsonDoc[JSON_BRIGHTNESS_KEY] = state->brightness;
+        jsonDoc[JSON_COLOR_MODE_KEY] = F("rgbw");
+        jsonDoc[JSON_COLOR_KEY][JSON_RED_KEY] = state->red;
+        jsonDoc[JSON_COLOR_KEY][JSON_GREEN_KEY] = state->green;
+        jsonDoc[JSON_COLOR_KEY][JSON_BLUE_KEY] = state->blue;
+        jsonDoc[JSON_COLOR_KEY][JSON_WHITE_KEY] = state->white;
+
+        LightEffect effect = state->lightEffect;
+
+        if (LedUtils::EffectFromName(LedUtils::EffectNameFromEnum(effect)) == LightEffect::unknown)
+        {
+            // Solid as fallback
+            effect = LightEffect::solid;
+        }
+
+        jsonDoc[JSON_EFFECT_KEY] = LedUtils::EffectNameFromEnum(effect);
+
+        if (state->overlayEffect != LightEffect::unknown)
+        {
+            jsonDoc[JSON_OVERLAY_KEY] = LedUtils::EffectNameFromEnum(state->overlayEffect);
+        }
+    }
+};
+
+#endif // __LIGHTSTATEJSON_H__
@@ -0,0 +1,168 @@
+#include "Logger.h"
+#include "MemoryBudget.h"
+
+LogEntry Logger::_entries[LOG_BUFFER_ENTRIES];
+std::atomic<uint32_t> Logger::_head(0);
+std::atomic<uint32_t> Logger::_tail(0);
+std::atomic<uint32_t> Logger::_dropped(0);
+volatile uint8_t Logger::_level = LOG_LEVEL;
+volatile uint8_t Logger::_categories = (DEBUG ? LOG_GENERAL : 0) | (DEBUG_MQTT ? LOG_MQTT : 0) | (DEBUG_LIGHT ? LOG_LIGHT : 0);
+TaskHandle_t Logger::_task = nullptr;
+
+void Logger::setup()
+{
+    MemoryBudget::reserve(MemorySubsystem::logBuffer, sizeof(_entries));
+
+    // below the render and network tasks, printing is the least important work
+    xTaskCreate(drain, "logger", 3072, nullptr, tskIDLE_PRIORITY, &_task);
+}
+
+bool Logger::isEnabled(uint8_t level, uint8_t category)
+{
+    if (level > _level)
+        return false;
+
+    // errors, warnings and info are always printed, debug messages only for enabled categories
+    return level < LOG_LEVEL_DEBUG || (_categories & category) != 0;
+}
+
+void Logger::logText(uint8_t level, uint8_t category, const char *format, const char *text, size_t length)
+{
+    write(level, category, format, nullptr, text, length);
+}
+
+void Logger::write(uint8_t level, uint8_t category, const char *format, const uint32_t *args, const char *text, size_t length)
+{
+    if (!isEnabled(level, category))
+        return;
+
+    // reserve a slot, several tasks may log at the same time
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    do
+    {
+        if (head - _tail.load(std::memory_order_acquire) >= LOG_BUFFER_ENTRIES)
+        {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    LogEntry *entry = &_entries[head % LOG_BUFFER_ENTRIES];
+    entry->level = level;
+    entry->millis = millis();
+    entry->format = format;
+
+    entry->hasText = text != nullptr;
+
+    if (entry->hasText)
+    {
+        size_t textLength = strnlen(text, min(length, sizeof(entry->text) - 1));
+        memcpy(entry->text, text, textLength);
+        entry->text[textLength] = '\0';
+    }
+    else
+        memcpy(entry->args, args, sizeof(entry->args));
+
+    entry->ready.store(true, std::memory_order_release);
+
+    // the drain task only needs a nudge when it might be waiting for an empty buffer
+    if (_task != nullptr && head == _tail.load(std::memory_order_relaxed))
+        xTaskNotifyGive(_task);
+}
+
+void Logger::drain(void *parameter)
+{
+    char line[160];
+    uint32_t reportedDropped = 0;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+        while (tail != _head.load(std::memory_order_acquire))
+        {
+            LogEntry *entry = &_entries[tail % LOG_BUFFER_ENTRIES];
+
+            // the slot is reserved, but the producer is not done yet
+            if (!entry->ready.load(std::memory_order_acquire))
+                break;
+
+            int length = snprintf(line, sizeof(line), "[%6u] %-5s ", (unsigned)entry->millis, LevelName(entry->level));
+
+            // on the ESP32 every argument (integer or pointer) is 32 bit wide
+            if (entry->hasText)
+                snprintf(line + length, sizeof(line) - length, entry->format, entry->text);
+            else
+                snprintf(line + length, sizeof(line) - length, entry->format,
+                         entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+
+            entry->ready.store(false, std::memory_order_relaxed);
+            tail++;
+            _tail.store(tail, std::memory_order_release);
+
+            Serial.println(line);
+        }
+
+        uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+        if (dropped != reportedDropped)
+        {
+            Serial.printf("[logger] %u messages dropped\n", (unsigned)(dropped - reportedDropped));
+            reportedDropped = dropped;
+        }
+    }
+}
+
+void Logger::setLevel(uint8_t level)
+{
+    _level = level;
+}
+
+uint8_t Logger::getLevel()
+{
+    return _level;
+}
+
+void Logger::setCategories(uint8_t categories)
+{
+    _categories = categories;
+}
+
+uint8_t Logger::getCategories()
+{
+    return _categories;
+}
+
+uint32_t Logger::getDropped()
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+const char *Logger::LevelName(uint8_t level)
+{
+    switch (level)
+    {
+    case LOG_LEVEL_ERROR:
+        return "ERROR";
+    case LOG_LEVEL_WARN:
+        return "WARN";
+    case LOG_LEVEL_INFO:
+        return "INFO";
+    case LOG_LEVEL_DEBUG:
+        return "DEBUG";
+    default:
+        return "?";
+    }
+}
+
+uint8_t Logger::LevelFromName(const char *name)
+{
+    for (uint8_t level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_DEBUG; level++)
+    {
+        if (strcasecmp(name, LevelName(level)) == 0)
+            return level;
+    }
+
+    return 0;
+}
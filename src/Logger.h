@@ -0,0 +1,173 @@
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <Arduino.h>
+#include <atomic>
+
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// messages above this level are removed at compile time
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#ifndef LOG_BUFFER_ENTRIES
+#define LOG_BUFFER_ENTRIES 32
+#endif
+
+#define LOG_MAX_ARGS 4
+#define LOG_TEXT_LENGTH 64
+
+// Debug messages belong to a category that can be switched on and off at runtime,
+// the former DEBUG, DEBUG_MQTT and DEBUG_LIGHT flags only set the initial state
+#define LOG_GENERAL 0x01
+#define LOG_MQTT 0x02
+#define LOG_LIGHT 0x04
+
+#ifndef DEBUG
+#define DEBUG 0
+#endif
+#ifndef DEBUG_MQTT
+#define DEBUG_MQTT 0
+#endif
+#ifndef DEBUG_LIGHT
+#define DEBUG_LIGHT 0
+#endif
+
+// a message above LOG_LEVEL expands to an empty statement, neither the call nor its arguments are compiled.
+// The *_TEXT variants copy a string that does not outlive the call, see Logger::logText()
+#define LOG_AT(level, category, ...) Logger::log(level, category, __VA_ARGS__)
+#define LOG_TEXT_AT(level, category, ...) Logger::logText(level, category, __VA_ARGS__)
+#define LOG_NOTHING(...) \
+    do                   \
+    {                    \
+    } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, LOG_GENERAL, __VA_ARGS__)
+#define LOG_ERROR_TEXT(...) LOG_TEXT_AT(LOG_LEVEL_ERROR, LOG_GENERAL, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_NOTHING()
+#define LOG_ERROR_TEXT(...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, LOG_GENERAL, __VA_ARGS__)
+#define LOG_WARN_TEXT(...) LOG_TEXT_AT(LOG_LEVEL_WARN, LOG_GENERAL, __VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_NOTHING()
+#define LOG_WARN_TEXT(...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, LOG_GENERAL, __VA_ARGS__)
+#define LOG_INFO_TEXT(...) LOG_TEXT_AT(LOG_LEVEL_INFO, LOG_GENERAL, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_NOTHING()
+#define LOG_INFO_TEXT(...) LOG_NOTHING()
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#define LOG_DEBUG_TEXT(category, ...) LOG_TEXT_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) LOG_NOTHING()
+#define LOG_DEBUG_TEXT(category, ...) LOG_NOTHING()
+#endif
+
+/**
+ * @brief One message, formatted by the drain task
+ */
+struct LogEntry
+{
+    std::atomic<bool> ready;
+    uint8_t level;
+    bool hasText;
+    uint32_t millis;
+    const char *format;
+    uint32_t args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_LENGTH];
+};
+
+/**
+ * @brief Asynchronous logger, the callers never wait for the serial port.
+ *
+ * A log call stores the format string and its (integer or static string) arguments in a
+ * lock-free ring buffer, formatting and printing is done by a low priority task. When the
+ * buffer is full the message is dropped and counted instead of blocking the caller.
+ */
+class Logger
+{
+private:
+    static LogEntry _entries[LOG_BUFFER_ENTRIES];
+    static std::atomic<uint32_t> _head;
+    static std::atomic<uint32_t> _tail;
+    static std::atomic<uint32_t> _dropped;
+    static volatile uint8_t _level;
+    static volatile uint8_t _categories;
+    static TaskHandle_t _task;
+
+    static void write(uint8_t level, uint8_t category, const char *format, const uint32_t *args, const char *text, size_t length);
+    static void drain(void *parameter);
+
+    template <typename T>
+    static uint32_t toArg(T value)
+    {
+        return (uint32_t)value;
+    }
+
+    template <typename T>
+    static uint32_t toArg(T *value)
+    {
+        return (uint32_t)(uintptr_t)value;
+    }
+
+public:
+    /**
+     * @brief Start the drain task, messages logged before are kept in the buffer
+     */
+    static void setup();
+
+    /**
+     * @brief Queue a message
+     *
+     * @param level One of the LOG_LEVEL_* values
+     * @param category One of the LOG_* categories, only relevant for debug messages
+     * @param format A printf format that lives as long as the program (a literal)
+     * @param args Up to 4 integers or static strings
+     */
+    template <typename... Args>
+    static void log(uint8_t level, uint8_t category, const char *format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+
+        uint32_t values[LOG_MAX_ARGS] = {toArg(args)...};
+        write(level, category, format, values, nullptr, 0);
+    }
+
+    /**
+     * @brief Queue a message with a string that does not outlive the call, it gets copied (and truncated).
+     * Use the LOG_*_TEXT macros, they remove the call above LOG_LEVEL
+     *
+     * @param format A printf format with a single %s for the text
+     * @param text The text, it does not need to be terminated when the length is given
+     * @param length The maximum number of characters to copy
+     */
+    static void logText(uint8_t level, uint8_t category, const char *format, const char *text, size_t length = SIZE_MAX);
+
+    static bool isEnabled(uint8_t level, uint8_t category);
+
+    static void setLevel(uint8_t level);
+    static uint8_t getLevel();
+    static void setCategories(uint8_t categories);
+    static uint8_t getCategories();
+    static uint32_t getDropped();
+
+    static const char *LevelName(uint8_t level);
+    static uint8_t LevelFromName(const char *name);
+};
+
+#endif // __LOGGER_H__
@@ -0,0 +1,158 @@
+#include "MemoryBudget.h"
+#include "Logger.h"
+
+uint8_t MemoryBudget::_arena[BOOT_ARENA_SIZE] __attribute__((aligned(4)));
+size_t MemoryBudget::_arenaUsed = 0;
+bool MemoryBudget::_sealed = false;
+size_t MemoryBudget::_subsystemBytes[MemorySubsystem::subsystemCount] = {0};
+std::atomic<uint32_t> MemoryBudget::_allocationsAfterBoot(0);
+std::atomic<uint32_t> MemoryBudget::_bytesAfterBoot(0);
+std::atomic<uint32_t> MemoryBudget::_hotPathAllocations(0);
+
+// every task tracks by itself whether it is inside a hot path
+static thread_local uint8_t _hotPathDepth = 0;
+
+MemoryBudget::HotPathScope::HotPathScope()
+{
+    _hotPathDepth++;
+}
+
+MemoryBudget::HotPathScope::~HotPathScope()
+{
+    _hotPathDepth--;
+}
+
+void *MemoryBudget::allocate(MemorySubsystem subsystem, size_t size)
+{
+    if (_sealed)
+    {
+        LOG_ERROR("boot arena is sealed, '%s' requested %u bytes", SubsystemName(subsystem), size);
+        return nullptr;
+    }
+
+    size_t alignedSize = (size + 3) & ~static_cast<size_t>(3);
+
+    if (_arenaUsed + alignedSize > BOOT_ARENA_SIZE)
+    {
+        LOG_ERROR("boot arena exhausted, '%s' requested %u bytes", SubsystemName(subsystem), size);
+        return nullptr;
+    }
+
+    void *buffer = &_arena[_arenaUsed];
+    _arenaUsed += alignedSize;
+    _subsystemBytes[subsystem] += alignedSize;
+
+    return buffer;
+}
+
+void MemoryBudget::reserve(MemorySubsystem subsystem, size_t size)
+{
+    _subsystemBytes[subsystem] += size;
+}
+
+void MemoryBudget::seal()
+{
+    _sealed = true;
+}
+
+void MemoryBudget::countAllocation(size_t size)
+{
+    if (!_sealed)
+        return;
+
+    _allocationsAfterBoot.fetch_add(1, std::memory_order_relaxed);
+    _bytesAfterBoot.fetch_add(size, std::memory_order_relaxed);
+
+    if (_hotPathDepth > 0)
+        _hotPathAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t MemoryBudget::allocationsAfterBoot()
+{
+    return _allocationsAfterBoot.load(std::memory_order_relaxed);
+}
+
+uint32_t MemoryBudget::bytesAfterBoot()
+{
+    return _bytesAfterBoot.load(std::memory_order_relaxed);
+}
+
+uint32_t MemoryBudget::hotPathAllocations()
+{
+    return _hotPathAllocations.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::report(Print &out)
+{
+    out.println(F("Memory budget"));
+
+    for (size_t i = 0; i < MemorySubsystem::subsystemCount; i++)
+    {
+        out.printf("  %-16s %6u B\n", SubsystemName(static_cast<MemorySubsystem>(i)), (unsigned)_subsystemBytes[i]);
+    }
+
+    out.printf("  boot arena       %6u / %u B%s\n", (unsigned)_arenaUsed, (unsigned)BOOT_ARENA_SIZE, _sealed ? " (sealed)" : "");
+    out.printf("  heap free        %6u B, min free %u B, largest block %u B\n",
+               (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap(), (unsigned)ESP.getMaxAllocHeap());
+
+#if STATIC_MEMORY
+    out.printf("  allocations after boot: %u (%u B), in hot paths: %u\n",
+               (unsigned)allocationsAfterBoot(), (unsigned)bytesAfterBoot(), (unsigned)hotPathAllocations());
+#else
+    out.println(F("  allocation guard disabled (STATIC_MEMORY=0)"));
+#endif
+}
+
+const char *MemoryBudget::SubsystemName(MemorySubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case MemorySubsystem::ledBuffers:
+        return "led buffers";
+    case MemorySubsystem::jsonDocuments:
+        return "json documents";
+    case MemorySubsystem::mqttBuffers:
+        return "mqtt buffers";
+    case MemorySubsystem::topicStrings:
+        return "topic strings";
+    case MemorySubsystem::effectState:
+        return "effect state";
+    case MemorySubsystem::presets:
+        return "presets";
+    case MemorySubsystem::layoutTables:
+        return "layout tables";
+    case MemorySubsystem::logBuffer:
+        return "log buffer";
+    default:
+        return "unknown";
+    }
+}
+
+#if STATIC_MEMORY
+// The linker redirects every malloc/calloc/realloc to these wrappers (-Wl,--wrap=...),
+// this way allocations inside the libraries are counted as well
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        MemoryBudget::countAllocation(size);
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        MemoryBudget::countAllocation(count * size);
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        MemoryBudget::countAllocation(size);
+        return __real_realloc(ptr, size);
+    }
+}
+#endif
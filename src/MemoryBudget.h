@@ -0,0 +1,112 @@
+#ifndef __MEMORYBUDGET_H__
+#define __MEMORYBUDGET_H__
+
+#include <Arduino.h>
+#include <atomic>
+
+#ifndef STATIC_MEMORY
+#define STATIC_MEMORY 0
+#endif
+
+// size of the arena that subsystems may carve their buffers from during setup
+#ifndef BOOT_ARENA_SIZE
+#define BOOT_ARENA_SIZE 16384
+#endif
+
+#define JSON_DOCUMENT_SIZE 512
+#define MQTT_PAYLOAD_BUFFER_SIZE 512
+
+// In the static memory mode the JSON documents and payload buffers move from the
+// (small) AsyncTCP task stack into .bss
+#if STATIC_MEMORY
+#define STATIC_MEMORY_STORAGE static
+#else
+#define STATIC_MEMORY_STORAGE
+#endif
+
+enum MemorySubsystem
+{
+    ledBuffers,
+    jsonDocuments,
+    mqttBuffers,
+    topicStrings,
+    effectState,
+    presets,
+    layoutTables,
+    logBuffer,
+    subsystemCount
+};
+
+/**
+ * @brief Compile time and boot time memory accounting.
+ *
+ * Every subsystem either reserves its statically sized storage or allocates it from
+ * the boot arena. Once the boot is finished (setup done and the first network connection
+ * up) the budget gets sealed: the arena refuses further allocations and the allocation
+ * guard starts counting heap usage.
+ */
+class MemoryBudget
+{
+private:
+    static uint8_t _arena[BOOT_ARENA_SIZE];
+    static size_t _arenaUsed;
+    static bool _sealed;
+    static size_t _subsystemBytes[MemorySubsystem::subsystemCount];
+    static std::atomic<uint32_t> _allocationsAfterBoot;
+    static std::atomic<uint32_t> _bytesAfterBoot;
+    static std::atomic<uint32_t> _hotPathAllocations;
+
+public:
+    /**
+     * @brief Marks a region of code that must not touch the heap, allocations made by
+     * the current task while a scope is alive are counted as hot path allocations
+     */
+    class HotPathScope
+    {
+    public:
+        HotPathScope();
+        ~HotPathScope();
+    };
+
+    /**
+     * @brief Take a buffer from the boot arena, only possible until the budget is sealed
+     *
+     * @param subsystem The subsystem the buffer gets accounted to
+     * @param size The number of bytes required
+     * @return void* The buffer (4 byte aligned) or nullptr when sealed or exhausted
+     */
+    static void *allocate(MemorySubsystem subsystem, size_t size);
+
+    /**
+     * @brief Account statically sized storage (.bss or library owned) to a subsystem
+     *
+     * @param subsystem The subsystem the storage belongs to
+     * @param size The number of bytes
+     */
+    static void reserve(MemorySubsystem subsystem, size_t size);
+
+    /**
+     * @brief Finish the boot phase, the arena gets closed and the allocation guard armed
+     */
+    static void seal();
+
+    /**
+     * @brief Called by the malloc wrappers for every heap allocation
+     */
+    static void countAllocation(size_t size);
+
+    static uint32_t allocationsAfterBoot();
+    static uint32_t bytesAfterBoot();
+    static uint32_t hotPathAllocations();
+
+    /**
+     * @brief Print the memory budget per subsystem and the current heap situation
+     *
+     * @param out The target to print to
+     */
+    static void report(Print &out);
+
+    static const char *SubsystemName(MemorySubsystem subsystem);
+};
+
+#endif // __MEMORYBUDGET_H__
@@ -0,0 +1,79 @@
+#include "NeoPixelDriver.h"
+#include "LedUtils.h"
+#include "MemoryBudget.h"
+
+NeoPixelDriver::NeoPixelDriver(uint8_t pin) : _strip()
+{
+    _chipset = LedChipset::sk6812;
+    _pin = pin;
+}
+
+bool NeoPixelDriver::begin(LedChipset chipset, uint16_t pixelCount)
+{
+    if (chipset != LedChipset::ws2812 && chipset != LedChipset::sk6812)
+        return false;
+
+    _chipset = chipset;
+    _strip.updateType(_chipset == LedChipset::sk6812 ? NEO_GRBW + NEO_KHZ800 : NEO_GRB + NEO_KHZ800);
+    _strip.updateLength(pixelCount);
+    _strip.setPin(_pin);
+    _strip.begin();
+
+    // the pixel buffer is allocated by Adafruit_NeoPixel
+    MemoryBudget::reserve(MemorySubsystem::ledBuffers, frameBytes());
+
+    return _strip.numPixels() == pixelCount;
+}
+
+void NeoPixelDriver::setPixel(uint16_t index, uint32_t color)
+{
+    if (_chipset == LedChipset::ws2812)
+    {
+        // there is no white LED, add the white channel to red, green and blue
+        uint8_t white = color >> 24;
+        color = LedUtils::AddSaturate(color & 0x00FFFFFF, white * 0x00010101);
+    }
+
+    _strip.setPixelColor(index, color);
+}
+
+void NeoPixelDriver::setBrightness(uint8_t brightness)
+{
+    _strip.setBrightness(brightness);
+}
+
+uint8_t NeoPixelDriver::getBrightness()
+{
+    return _strip.getBrightness();
+}
+
+void NeoPixelDriver::clear()
+{
+    _strip.clear();
+}
+
+void NeoPixelDriver::show()
+{
+    _strip.show();
+}
+
+uint16_t NeoPixelDriver::numPixels()
+{
+    return _strip.numPixels();
+}
+
+size_t NeoPixelDriver::frameBytes()
+{
+    return _strip.numPixels() * (_chipset == LedChipset::sk6812 ? 4 : 3);
+}
+
+uint32_t NeoPixelDriver::wireMicros()
+{
+    // 1.25 us per bit
+    return (frameBytes() * 8 * 125) / 100 + NEOPIXEL_LATCH_MICROS;
+}
+
+LedChipset NeoPixelDriver::chipset()
+{
+    return _chipset;
+}
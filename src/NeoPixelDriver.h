@@ -0,0 +1,35 @@
+#ifndef __NEOPIXELDRIVER_H__
+#define __NEOPIXELDRIVER_H__
+
+#include "Adafruit_NeoPixel.h"
+#include "LedDriver.h"
+
+// the data sheets ask for more than 280 us low to latch a frame
+#define NEOPIXEL_LATCH_MICROS 300
+
+/**
+ * @brief Single wire 800 kHz strips (WS2812 RGB, SK6812 RGBW) through Adafruit_NeoPixel
+ */
+class NeoPixelDriver : public LedDriver
+{
+private:
+    Adafruit_NeoPixel _strip;
+    LedChipset _chipset;
+    uint8_t _pin;
+
+public:
+    NeoPixelDriver(uint8_t pin);
+
+    bool begin(LedChipset chipset, uint16_t pixelCount) override;
+    void setPixel(uint16_t index, uint32_t color) override;
+    void setBrightness(uint8_t brightness) override;
+    uint8_t getBrightness() override;
+    void clear() override;
+    void show() override;
+    uint16_t numPixels() override;
+    size_t frameBytes() override;
+    uint32_t wireMicros() override;
+    LedChipset chipset() override;
+};
+
+#endif // __NEOPIXELDRIVER_H__
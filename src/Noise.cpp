@@ -0,0 +1,225 @@
+#include "Noise.h"
+
+// the permutation of Ken Perlin's reference implementation, doubled to skip the wrap of the second lookup
+static const uint8_t _permutation[512] = {
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180};
+
+// the fraction inside a cell is reduced to 12 bits, this way every product fits into 32 bits
+#define FRACTION_BITS 12
+#define FRACTION_ONE (1 << FRACTION_BITS)
+
+static inline int32_t fraction(uint32_t coordinate)
+{
+    return (coordinate & 0xFFFF) >> (16 - FRACTION_BITS);
+}
+
+static inline uint8_t cell(uint32_t coordinate)
+{
+    return coordinate >> 16;
+}
+
+// smoothstep 3t^2 - 2t^3, the lattice points do not show up as kinks
+static inline int32_t fade(int32_t t)
+{
+    int32_t t2 = (t * t) >> FRACTION_BITS;
+    int32_t t3 = (t2 * t) >> FRACTION_BITS;
+
+    return 3 * t2 - 2 * t3;
+}
+
+static inline int32_t lerp(int32_t a, int32_t b, int32_t t)
+{
+    return a + (((b - a) * t) >> FRACTION_BITS);
+}
+
+static inline int32_t gradient1D(uint8_t hash, int32_t x)
+{
+    // slopes of -2, -1, 1 and 2
+    int32_t slope = (hash & 1) + 1;
+    return (hash & 2) ? -slope * x : slope * x;
+}
+
+static inline int32_t gradient2D(uint8_t hash, int32_t x, int32_t y)
+{
+    // the four diagonals and the four axes
+    switch (hash & 7)
+    {
+    case 0:
+        return x + y;
+    case 1:
+        return -x + y;
+    case 2:
+        return x - y;
+    case 3:
+        return -x - y;
+    case 4:
+        return x;
+    case 5:
+        return -x;
+    case 6:
+        return y;
+    default:
+        return -y;
+    }
+}
+
+static inline int32_t gradient3D(uint8_t hash, int32_t x, int32_t y, int32_t z)
+{
+    // the twelve edges of a cube, as in the improved noise reference
+    uint8_t h = hash & 15;
+    int32_t u = h < 8 ? x : y;
+    int32_t v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+// scales the raw noise (about -1 to 1 in FRACTION_BITS fixed point) to a sample around 128,
+// the gain (256 = 1) stretches the range that is actually reached to 0-255
+static inline uint8_t toSample(int32_t value, int32_t gain)
+{
+    int32_t sample = 128 + ((value * gain) >> (FRACTION_BITS - 7 + 8));
+
+    return constrain(sample, (int32_t)0, (int32_t)255);
+}
+
+uint8_t Noise::Sample1D(uint32_t x)
+{
+    uint8_t xi = cell(x);
+    int32_t xf = fraction(x);
+
+    int32_t a = gradient1D(_permutation[xi], xf);
+    int32_t b = gradient1D(_permutation[xi + 1], xf - FRACTION_ONE);
+
+    return toSample(lerp(a, b, fade(xf)), 224);
+}
+
+uint8_t Noise::Sample2D(uint32_t x, uint32_t y)
+{
+    uint8_t xi = cell(x);
+    uint8_t yi = cell(y);
+    int32_t xf = fraction(x);
+    int32_t yf = fraction(y);
+
+    uint8_t a = _permutation[xi] + yi;
+    uint8_t b = _permutation[xi + 1] + yi;
+
+    int32_t u = fade(xf);
+    int32_t v = fade(yf);
+
+    int32_t x1 = lerp(gradient2D(_permutation[a], xf, yf),
+                      gradient2D(_permutation[b], xf - FRACTION_ONE, yf), u);
+    int32_t x2 = lerp(gradient2D(_permutation[a + 1], xf, yf - FRACTION_ONE),
+                      gradient2D(_permutation[b + 1], xf - FRACTION_ONE, yf - FRACTION_ONE), u);
+
+    return toSample(lerp(x1, x2, v), 400);
+}
+
+uint8_t Noise::Sample3D(uint32_t x, uint32_t y, uint32_t z)
+{
+    uint8_t xi = cell(x);
+    uint8_t yi = cell(y);
+    uint8_t zi = cell(z);
+    int32_t xf = fraction(x);
+    int32_t yf = fraction(y);
+    int32_t zf = fraction(z);
+
+    uint8_t a = _permutation[xi] + yi;
+    uint8_t aa = _permutation[a] + zi;
+    uint8_t ab = _permutation[a + 1] + zi;
+    uint8_t b = _permutation[xi + 1] + yi;
+    uint8_t ba = _permutation[b] + zi;
+    uint8_t bb = _permutation[b + 1] + zi;
+
+    int32_t u = fade(xf);
+    int32_t v = fade(yf);
+    int32_t w = fade(zf);
+
+    int32_t x1 = lerp(gradient3D(_permutation[aa], xf, yf, zf),
+                      gradient3D(_permutation[ba], xf - FRACTION_ONE, yf, zf), u);
+    int32_t x2 = lerp(gradient3D(_permutation[ab], xf, yf - FRACTION_ONE, zf),
+                      gradient3D(_permutation[bb], xf - FRACTION_ONE, yf - FRACTION_ONE, zf), u);
+    int32_t y1 = lerp(x1, x2, v);
+
+    x1 = lerp(gradient3D(_permutation[aa + 1], xf, yf, zf - FRACTION_ONE),
+              gradient3D(_permutation[ba + 1], xf - FRACTION_ONE, yf, zf - FRACTION_ONE), u);
+    x2 = lerp(gradient3D(_permutation[ab + 1], xf, yf - FRACTION_ONE, zf - FRACTION_ONE),
+              gradient3D(_permutation[bb + 1], xf - FRACTION_ONE, yf - FRACTION_ONE, zf - FRACTION_ONE), u);
+    int32_t y2 = lerp(x1, x2, v);
+
+    return toSample(lerp(y1, y2, w), 400);
+}
+
+uint8_t Noise::Fractal2D(uint32_t x, uint32_t y, uint8_t octaves)
+{
+    octaves = constrain(octaves, (uint8_t)1, (uint8_t)NOISE_MAX_OCTAVES);
+
+    int32_t sum = 0;
+    int32_t amplitude = 256;
+    int32_t total = 0;
+
+    for (uint8_t i = 0; i < octaves; i++)
+    {
+        sum += (Sample2D(x, y) - 128) * amplitude;
+        total += amplitude;
+
+        x <<= 1;
+        y <<= 1;
+        amplitude >>= 1;
+    }
+
+    // the octaves rarely peak together, the sum is stretched back to the full range
+    return constrain(128 + sum * 3 / (total * 2), (int32_t)0, (int32_t)255);
+}
+
+uint8_t Noise::Fractal3D(uint32_t x, uint32_t y, uint32_t z, uint8_t octaves)
+{
+    octaves = constrain(octaves, (uint8_t)1, (uint8_t)NOISE_MAX_OCTAVES);
+
+    int32_t sum = 0;
+    int32_t amplitude = 256;
+    int32_t total = 0;
+
+    for (uint8_t i = 0; i < octaves; i++)
+    {
+        sum += (Sample3D(x, y, z) - 128) * amplitude;
+        total += amplitude;
+
+        x <<= 1;
+        y <<= 1;
+        z <<= 1;
+        amplitude >>= 1;
+    }
+
+    return constrain(128 + sum * 3 / (total * 2), (int32_t)0, (int32_t)255);
+}
@@ -0,0 +1,38 @@
+#ifndef __NOISE_H__
+#define __NOISE_H__
+
+#include <Arduino.h>
+
+// the coordinates are 16.16 fixed point, one lattice cell is 65536
+#define NOISE_CELL 65536
+#define NOISE_MAX_OCTAVES 4
+
+/**
+ * @brief Gradient (Perlin) noise in pure integer arithmetic.
+ *
+ * Coordinates are 16.16 fixed point, the lattice repeats every 256 cells. A coordinate that
+ * advances by a power of two times 256 cells per wrap of a counter therefore animates without a seam.
+ * The samples are 0-255 (128 is the mean) to be used as palette index, hue or brightness.
+ * There are no floats, every target computes bit identical values.
+ */
+class Noise
+{
+public:
+    static uint8_t Sample1D(uint32_t x);
+    static uint8_t Sample2D(uint32_t x, uint32_t y);
+    static uint8_t Sample3D(uint32_t x, uint32_t y, uint32_t z);
+
+    /**
+     * @brief Several octaves of 2D noise, every octave doubles the frequency and halves the amplitude
+     *
+     * @param octaves 1-4, the details get finer with every octave, other values are clamped
+     */
+    static uint8_t Fractal2D(uint32_t x, uint32_t y, uint8_t octaves);
+
+    /**
+     * @brief Several octaves of 3D noise, see Fractal2D
+     */
+    static uint8_t Fractal3D(uint32_t x, uint32_t y, uint32_t z, uint8_t octaves);
+};
+
+#endif // __NOISE_H__
@@ -0,0 +1,212 @@
+#include "ParticleSystem.h"
+#include "LedUtils.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+
+bool ParticleSystem::setup(uint8_t owners, uint16_t share)
+{
+    if (owners > PARTICLE_MAX_OWNERS)
+        owners = PARTICLE_MAX_OWNERS;
+
+    uint16_t capacity = owners * share;
+
+    _position = static_cast<int32_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity * sizeof(int32_t)));
+    _velocity = static_cast<int16_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity * sizeof(int16_t)));
+    _life = static_cast<uint8_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity));
+    _lifetime = static_cast<uint8_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity));
+    _owner = static_cast<uint8_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity));
+    _color = static_cast<uint32_t *>(MemoryBudget::allocate(MemorySubsystem::effectState, capacity * sizeof(uint32_t)));
+
+    if (_position == nullptr || _velocity == nullptr || _life == nullptr || _lifetime == nullptr || _owner == nullptr || _color == nullptr)
+    {
+        LOG_ERROR("particle pool could not be allocated");
+        return false;
+    }
+
+    _capacity = capacity;
+    _share = share;
+    _count = 0;
+
+    return true;
+}
+
+uint8_t ParticleSystem::random8()
+{
+    // xorshift, cheap and the same sequence on every target
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+
+    return _seed >> 24;
+}
+
+void ParticleSystem::spawn(uint8_t owner, int32_t position, int16_t velocity, uint8_t lifetime, uint32_t color)
+{
+    // a full share skips the particle, the effect just gets a little sparser
+    if (owner >= PARTICLE_MAX_OWNERS || _ownerCount[owner] >= _share || _count >= _capacity || lifetime == 0)
+        return;
+
+    _position[_count] = position;
+    _velocity[_count] = velocity;
+    _life[_count] = lifetime;
+    _lifetime[_count] = lifetime;
+    _owner[_count] = owner;
+    _color[_count] = color;
+    _count++;
+    _ownerCount[owner]++;
+}
+
+void ParticleSystem::remove(uint16_t index)
+{
+    // the last particle fills the gap, the alive particles stay contiguous
+    _ownerCount[_owner[index]]--;
+    _count--;
+
+    _position[index] = _position[_count];
+    _velocity[index] = _velocity[_count];
+    _life[index] = _life[_count];
+    _lifetime[index] = _lifetime[_count];
+    _owner[index] = _owner[_count];
+    _color[index] = _color[_count];
+}
+
+void ParticleSystem::emit(uint8_t owner, LightEffect effect, uint32_t color, uint16_t pixelCount, uint16_t cycle)
+{
+    if (pixelCount == 0)
+        return;
+
+    // the light could be set to black, the particles would be invisible
+    if (color == 0)
+        color = Adafruit_NeoPixel::Color(255, 255, 255);
+
+    switch (effect)
+    {
+    case LightEffect::fire:
+        // embers rise from the start of the strip and cool down on the way
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            int32_t position = (int32_t)(random8() % 3) << 16;
+            int16_t velocity = 96 + random8();
+            uint32_t ember = Adafruit_NeoPixel::Color(255, 40 + (random8() % 160), 0);
+
+            spawn(owner, position, velocity, 16 + (random8() % 24), ember);
+        }
+        break;
+    case LightEffect::sparkle:
+        // about one new sparkle per 32 pixels and frame
+        for (uint16_t i = 0; i <= pixelCount / 32; i++)
+        {
+            uint16_t pixel = ((random8() << 8) | random8()) % pixelCount;
+
+            spawn(owner, (int32_t)pixel << 16, 0, 6 + (random8() % 8), color);
+        }
+        break;
+    case LightEffect::meteor:
+    {
+        // the head leaves a trail of fading particles, it runs past the end before it starts over
+        uint16_t head = (cycle * 3 / 2) % (pixelCount + 32);
+
+        if (head < pixelCount)
+        {
+            spawn(owner, (int32_t)head << 16, 0, 24, color);
+
+            if (random8() < 64)
+                spawn(owner, (int32_t)head << 16, -(int16_t)(random8() >> 1), 12, color);
+        }
+        break;
+    }
+    case LightEffect::confetti:
+        for (uint16_t i = 0; i <= pixelCount / 64; i++)
+        {
+            uint16_t pixel = ((random8() << 8) | random8()) % pixelCount;
+            int16_t velocity = (int16_t)(random8() >> 1) - 64;
+
+            spawn(owner, (int32_t)pixel << 16, velocity, 30 + (random8() % 30), LedUtils::ColorFromWheel(random8()));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void ParticleSystem::update(uint8_t owner, uint16_t pixelCount)
+{
+    int32_t limit = (int32_t)pixelCount << 16;
+    uint16_t i = 0;
+
+    while (i < _count)
+    {
+        if (_owner[i] != owner)
+        {
+            i++;
+            continue;
+        }
+
+        _life[i]--;
+        _position[i] += (int32_t)_velocity[i] * 256;
+        _velocity[i] -= _velocity[i] / 16; // drag
+
+        if (_life[i] == 0 || _position[i] < 0 || _position[i] >= limit)
+            remove(i); // the moved particle gets checked next
+        else
+            i++;
+    }
+}
+
+void ParticleSystem::render(uint8_t owner, uint32_t *pixels, uint16_t pixelCount)
+{
+    for (uint16_t i = 0; i < _count; i++)
+    {
+        if (_owner[i] != owner)
+            continue;
+
+        uint16_t pixel = _position[i] >> 16;
+        uint16_t fraction = (_position[i] >> 8) & 255;
+
+        if (pixel >= pixelCount)
+            continue;
+
+        // linear fade over the lifetime, the light is shared by the two nearest pixels
+        uint32_t color = LedUtils::Scale(_color[i], (_life[i] * 256) / _lifetime[i]);
+
+        pixels[pixel] = LedUtils::AddSaturate(pixels[pixel], LedUtils::Scale(color, 256 - fraction));
+
+        if (fraction > 0 && pixel + 1 < pixelCount)
+            pixels[pixel + 1] = LedUtils::AddSaturate(pixels[pixel + 1], LedUtils::Scale(color, fraction));
+    }
+}
+
+void ParticleSystem::clear(uint8_t owner)
+{
+    uint16_t i = 0;
+
+    while (i < _count)
+    {
+        if (_owner[i] == owner)
+            remove(i);
+        else
+            i++;
+    }
+}
+
+void ParticleSystem::transfer(uint8_t from, uint8_t to)
+{
+    for (uint16_t i = 0; i < _count; i++)
+    {
+        if (_owner[i] == from)
+            _owner[i] = to;
+    }
+
+    _ownerCount[to] += _ownerCount[from];
+    _ownerCount[from] = 0;
+}
+
+uint16_t ParticleSystem::getCount()
+{
+    return _count;
+}
+
+uint16_t ParticleSystem::getCount(uint8_t owner)
+{
+    return owner < PARTICLE_MAX_OWNERS ? _ownerCount[owner] : 0;
+}
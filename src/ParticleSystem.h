@@ -0,0 +1,86 @@
+#ifndef __PARTICLESYSTEM_H__
+#define __PARTICLESYSTEM_H__
+
+#include <Arduino.h>
+#include "LightState.h"
+
+// Every owner (compositor layer) gets its own share of the pool, a busy layer cannot starve the
+// others. The share covers the busiest effect on the full strip: confetti on 150 pixels spawns 3
+// particles per frame that live 30-59 frames, about 133 are alive at any time.
+#ifndef PARTICLES_PER_OWNER
+#define PARTICLES_PER_OWNER 160
+#endif
+#define PARTICLE_MAX_OWNERS 4
+
+/**
+ * @brief A fixed pool of short-lived particles moving along the strip.
+ *
+ * The particles are kept as structure of arrays: every property lives in its own contiguous
+ * array and the alive particles are always the first count entries. Spawning appends, retiring
+ * moves the last particle into the gap, so update and render are tight loops without holes.
+ * Each particle belongs to the layer (owner) whose emitter spawned it.
+ */
+class ParticleSystem
+{
+private:
+    int32_t *_position = nullptr;   // 16.16 fixed point pixels
+    int16_t *_velocity = nullptr;   // 8.8 fixed point pixels per frame
+    uint8_t *_life = nullptr;       // remaining frames
+    uint8_t *_lifetime = nullptr;   // frames at spawn, the particle fades out over them
+    uint8_t *_owner = nullptr;
+    uint32_t *_color = nullptr;
+    uint16_t _capacity = 0;
+    uint16_t _count = 0;
+    uint16_t _share = 0;                    // the most particles one owner may have alive
+    uint16_t _ownerCount[PARTICLE_MAX_OWNERS] = {};
+    uint32_t _seed = 0x9E3779B9;
+
+    uint8_t random8();
+    void spawn(uint8_t owner, int32_t position, int16_t velocity, uint8_t lifetime, uint32_t color);
+    void remove(uint16_t index);
+
+public:
+    /**
+     * @brief Allocate the pool from the boot arena, must be called during setup
+     *
+     * @param owners The number of owners, at most PARTICLE_MAX_OWNERS
+     * @param share The particles each owner may have alive, the pool holds owners * share
+     */
+    bool setup(uint8_t owners, uint16_t share);
+
+    /**
+     * @brief Spawn the particles of one frame for an effect
+     *
+     * @param owner The layer the particles belong to
+     * @param effect fire, sparkle, meteor or confetti
+     * @param color The color of the light state
+     * @param pixelCount The length of the strip
+     * @param cycle The frame counter of the layer
+     */
+    void emit(uint8_t owner, LightEffect effect, uint32_t color, uint16_t pixelCount, uint16_t cycle);
+
+    /**
+     * @brief Move the particles of an owner by one frame, expired and escaped particles are retired
+     */
+    void update(uint8_t owner, uint16_t pixelCount);
+
+    /**
+     * @brief Add the particles of an owner to a pixel buffer, split between the two nearest pixels
+     */
+    void render(uint8_t owner, uint32_t *pixels, uint16_t pixelCount);
+
+    /**
+     * @brief Retire every particle of an owner
+     */
+    void clear(uint8_t owner);
+
+    /**
+     * @brief Hand the particles of an owner to another one, e.g. when a layer starts fading out
+     */
+    void transfer(uint8_t from, uint8_t to);
+
+    uint16_t getCount();
+    uint16_t getCount(uint8_t owner);
+};
+
+#endif // __PARTICLESYSTEM_H__
@@ -0,0 +1,146 @@
+#include "PowerManager.h"
+#include "Logger.h"
+
+void PowerManager::setup()
+{
+    _activitySinceMicros = micros();
+
+#if POWER_MANAGEMENT
+#if CONFIG_IDF_TARGET_ESP32C3
+    esp_pm_config_esp32c3_t config;
+#elif CONFIG_IDF_TARGET_ESP32S2
+    esp_pm_config_esp32s2_t config;
+#elif CONFIG_IDF_TARGET_ESP32S3
+    esp_pm_config_esp32s3_t config;
+#else
+    esp_pm_config_esp32_t config;
+#endif
+    _maxCpuMhz = getCpuFrequencyMhz();
+    config.max_freq_mhz = _maxCpuMhz;
+    config.min_freq_mhz = IDLE_CPU_FREQ_MHZ;
+    config.light_sleep_enable = POWER_LIGHT_SLEEP;
+
+    esp_err_t error = esp_pm_configure(&config);
+
+    if (error != ESP_OK)
+    {
+        // ESP_ERR_NOT_SUPPORTED, the prebuilt Arduino SDK comes without CONFIG_PM_ENABLE
+        LOG_INFO("no power management (%s), the render task switches the CPU clock", esp_err_to_name(error));
+        _scaling = ClockScaling::scalingCpuClock;
+        return;
+    }
+
+    error = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "render", &_cpuLock);
+
+    if (error != ESP_OK)
+    {
+        LOG_WARN("render power lock could not be created: %s", esp_err_to_name(error));
+        return;
+    }
+
+    _scaling = ClockScaling::scalingPmLock;
+#endif
+}
+
+void PowerManager::setActivity(RenderActivity activity, unsigned long nowMicros)
+{
+    if (activity == _activity)
+        return;
+
+    accountWallTime(nowMicros);
+    _activity = activity;
+
+    bool animated = activity == RenderActivity::activityAnimated;
+
+#if POWER_MANAGEMENT
+    if (_scaling == ClockScaling::scalingCpuClock)
+    {
+        // static and off frames are rare and short, the lowest clock Wi-Fi allows is enough
+        setCpuFrequencyMhz(animated ? _maxCpuMhz : IDLE_CPU_FREQ_MHZ);
+        return;
+    }
+#endif
+
+    if (_scaling != ClockScaling::scalingPmLock)
+        return;
+
+    if (animated && !_cpuLockHeld)
+    {
+        esp_pm_lock_acquire(_cpuLock);
+        _cpuLockHeld = true;
+    }
+    else if (!animated && _cpuLockHeld)
+    {
+        esp_pm_lock_release(_cpuLock);
+        _cpuLockHeld = false;
+    }
+}
+
+void PowerManager::addBusyTime(uint32_t busyMicros)
+{
+    _busyMicros[_activity] += busyMicros;
+}
+
+RenderActivity PowerManager::getActivity()
+{
+    return _activity;
+}
+
+void PowerManager::accountWallTime(unsigned long nowMicros)
+{
+    _wallMicros[_activity] += nowMicros - _activitySinceMicros;
+    _activitySinceMicros = nowMicros;
+}
+
+void PowerManager::report(Print &out)
+{
+    // read only, the report runs on another task than the render loop
+    unsigned long nowMicros = micros();
+    RenderActivity current = _activity;
+
+    out.printf("{\"power_management\":%s,\"scaling\":\"%s\",\"cpu_mhz\":%u,\"activity\":\"%s\",\"activities\":{",
+               _scaling != ClockScaling::scalingNone ? "true" : "false", ScalingName(_scaling),
+               (unsigned)getCpuFrequencyMhz(), ActivityName(current));
+
+    for (uint8_t i = 0; i < RenderActivity::activityCount; i++)
+    {
+        uint64_t wall = _wallMicros[i];
+        if (i == current)
+            wall += nowMicros - _activitySinceMicros;
+        uint32_t permille = wall > 0 ? static_cast<uint32_t>((_busyMicros[i] * 1000) / wall) : 0;
+
+        out.printf("%s\"%s\":{\"time_ms\":%u,\"render_busy_pct\":%u.%u}",
+                   i == 0 ? "" : ",", ActivityName(static_cast<RenderActivity>(i)),
+                   (unsigned)(wall / 1000), (unsigned)(permille / 10), (unsigned)(permille % 10));
+    }
+
+    out.print("}}");
+}
+
+const char *PowerManager::ActivityName(RenderActivity activity)
+{
+    switch (activity)
+    {
+    case RenderActivity::activityOff:
+        return "off";
+    case RenderActivity::activityStatic:
+        return "static";
+    case RenderActivity::activityAnimated:
+        return "animated";
+    default:
+        return "unknown";
+    }
+}
+
+const char *PowerManager::ScalingName(ClockScaling scaling)
+{
+    switch (scaling)
+    {
+    case ClockScaling::scalingPmLock:
+        return "pm_lock";
+    case ClockScaling::scalingCpuClock:
+        return "cpu_clock";
+    default:
+        return "none";
+    }
+}
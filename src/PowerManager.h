@@ -0,0 +1,94 @@
+#ifndef __POWERMANAGER_H__
+#define __POWERMANAGER_H__
+
+#include <Arduino.h>
+#include "esp_pm.h"
+
+#ifndef POWER_MANAGEMENT
+#define POWER_MANAGEMENT 0
+#endif
+
+// the lowest CPU clock while the output is static, Wi-Fi needs at least 80 MHz
+#ifndef IDLE_CPU_FREQ_MHZ
+#define IDLE_CPU_FREQ_MHZ 80
+#endif
+
+// automatic light sleep while every task is blocked
+#ifndef POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP 0
+#endif
+
+enum RenderActivity
+{
+    activityOff,
+    activityStatic,
+    activityAnimated,
+    activityCount
+};
+
+enum ClockScaling
+{
+    scalingNone,        // POWER_MANAGEMENT=0, the clock stays as it is
+    scalingPmLock,      // ESP-IDF power management, a CPU_FREQ_MAX lock while animated
+    scalingCpuClock     // the SDK has no CONFIG_PM_ENABLE, setCpuFrequencyMhz() switches the clock
+};
+
+/**
+ * @brief Scales the CPU clock with the render activity.
+ *
+ * While an animation runs the CPU runs at full clock, as soon as the output is static
+ * (or off) the clock drops to IDLE_CPU_FREQ_MHZ. With an SDK built with CONFIG_PM_ENABLE this
+ * goes through a CPU_FREQ_MAX lock of the ESP-IDF power management (and allows light sleep),
+ * the prebuilt Arduino SDK has no power management, there the clock is set directly.
+ * The time spent and the render time per activity are tracked to report the utilization.
+ */
+class PowerManager
+{
+private:
+    ClockScaling _scaling = ClockScaling::scalingNone;
+    esp_pm_lock_handle_t _cpuLock = nullptr;
+    bool _cpuLockHeld = false;
+    uint32_t _maxCpuMhz = 0;
+
+    RenderActivity _activity = RenderActivity::activityOff;
+    unsigned long _activitySinceMicros = 0;
+    uint64_t _wallMicros[RenderActivity::activityCount] = {0};
+    uint64_t _busyMicros[RenderActivity::activityCount] = {0};
+
+    void accountWallTime(unsigned long nowMicros);
+
+public:
+    /**
+     * @brief Configure the power management, has to be called during setup
+     */
+    void setup();
+
+    /**
+     * @brief Switch to another render activity, the CPU clock follows
+     *
+     * @param activity The activity of the frames to come
+     * @param nowMicros The current micros()
+     */
+    void setActivity(RenderActivity activity, unsigned long nowMicros);
+
+    /**
+     * @brief Account the time the render task was busy with a frame
+     *
+     * @param busyMicros The duration of the frame
+     */
+    void addBusyTime(uint32_t busyMicros);
+
+    RenderActivity getActivity();
+
+    /**
+     * @brief Write the utilization per activity as JSON
+     *
+     * @param out The target to print to
+     */
+    void report(Print &out);
+
+    static const char *ActivityName(RenderActivity activity);
+    static const char *ScalingName(ClockScaling scaling);
+};
+
+#endif // __POWERMANAGER_H__
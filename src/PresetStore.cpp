@@ -0,0 +1,163 @@
+#include "PresetStore.h"
+#include "MemoryBudget.h"
+#include "Logger.h"
+
+PresetStore::PresetStore(Preferences *preferences)
+{
+    _preferences = preferences;
+    memset(_presets, 0, sizeof(_presets));
+}
+
+void PresetStore::setup()
+{
+    MemoryBudget::reserve(MemorySubsystem::presets, sizeof(_presets) + sizeof(_blob));
+
+    load();
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    for (uint8_t id = 0; id < PRESET_COUNT; id++)
+    {
+        if (!_presets[id].used || !Logger::isEnabled(LOG_LEVEL_DEBUG, LOG_GENERAL))
+            continue;
+
+        // the name is printed later by the drain task and the slot can change until then, it gets copied
+        char text[PRESET_NAME_LENGTH + 8];
+        snprintf(text, sizeof(text), "%u: '%s'", id, _presets[id].name);
+        LOG_DEBUG_TEXT(LOG_GENERAL, "preset %s", text);
+    }
+#endif
+}
+
+/**
+ * @brief Read the presets in the current format
+ *
+ * @return true The blob exists and has the current version
+ */
+bool PresetStore::load()
+{
+    if (_preferences->getBytesLength(PREF_PRESETS_KEY) != sizeof(_blob))
+        return false;
+
+    _preferences->getBytes(PREF_PRESETS_KEY, _blob, sizeof(_blob));
+
+    if (_blob[0] != PRESET_FORMAT_VERSION)
+    {
+        LOG_WARN("preset format %u is not supported, starting without presets", _blob[0]);
+        return false;
+    }
+
+    for (uint8_t id = 0; id < PRESET_COUNT; id++)
+    {
+        const uint8_t *record = _blob + 1 + id * PRESET_RECORD_SIZE;
+        LightPreset *preset = &_presets[id];
+
+        preset->used = record[0] != 0;
+        memcpy(preset->name, record + 1, PRESET_NAME_LENGTH);
+        preset->name[PRESET_NAME_LENGTH - 1] = '\0';
+
+        record += 1 + PRESET_NAME_LENGTH;
+        preset->lightOn = record[0] != 0;
+        preset->red = record[1];
+        preset->green = record[2];
+        preset->blue = record[3];
+        preset->white = record[4];
+        preset->brightness = record[5];
+
+        // effects are only ever appended to LightEffect, a value from a newer firmware falls back to solid
+        preset->lightEffect = record[6] < LightEffect::effectCount ? static_cast<LightEffect>(record[6]) : LightEffect::solid;
+        preset->overlayEffect = record[7] < LightEffect::effectCount ? static_cast<LightEffect>(record[7]) : LightEffect::unknown;
+    }
+
+    return true;
+}
+
+const LightPreset *PresetStore::get(uint8_t id)
+{
+    if (id >= PRESET_COUNT || !_presets[id].used)
+        return nullptr;
+
+    return &_presets[id];
+}
+
+int PresetStore::find(const char *name)
+{
+    for (uint8_t id = 0; id < PRESET_COUNT; id++)
+    {
+        if (_presets[id].used && strcmp(_presets[id].name, name) == 0)
+            return id;
+    }
+
+    return -1;
+}
+
+bool PresetStore::save(uint8_t id, const char *name, const LightState *state)
+{
+    if (id >= PRESET_COUNT)
+        return false;
+
+    LightPreset *preset = &_presets[id];
+    preset->used = true;
+
+    // keep the name safe to embed in JSON without escaping
+    size_t length = 0;
+    for (size_t i = 0; name[i] != '\0' && length < PRESET_NAME_LENGTH - 1; i++)
+    {
+        char c = name[i];
+        if (isalnum(c) || c == ' ' || c == '_' || c == '-')
+            preset->name[length++] = c;
+    }
+    preset->name[length] = '\0';
+
+    preset->lightOn = state->lightOn;
+    preset->red = state->red;
+    preset->green = state->green;
+    preset->blue = state->blue;
+    preset->white = state->white;
+    preset->brightness = state->brightness;
+    preset->lightEffect = state->lightEffect;
+    preset->overlayEffect = state->overlayEffect;
+
+    persist();
+
+    return true;
+}
+
+bool PresetStore::remove(uint8_t id)
+{
+    if (id >= PRESET_COUNT)
+        return false;
+
+    memset(&_presets[id], 0, sizeof(LightPreset));
+    persist();
+
+    return true;
+}
+
+void PresetStore::persist()
+{
+    _blob[0] = PRESET_FORMAT_VERSION;
+
+    for (uint8_t id = 0; id < PRESET_COUNT; id++)
+    {
+        uint8_t *record = _blob + 1 + id * PRESET_RECORD_SIZE;
+        const LightPreset *preset = &_presets[id];
+
+        record[0] = preset->used ? 1 : 0;
+        memcpy(record + 1, preset->name, PRESET_NAME_LENGTH);
+
+        record += 1 + PRESET_NAME_LENGTH;
+        record[0] = preset->lightOn ? 1 : 0;
+        record[1] = preset->red;
+        record[2] = preset->green;
+        record[3] = preset->blue;
+        record[4] = preset->white;
+        record[5] = preset->brightness;
+        record[6] = static_cast<uint8_t>(preset->lightEffect);
+        record[7] = static_cast<uint8_t>(preset->overlayEffect);
+    }
+
+    if (_preferences->putBytes(PREF_PRESETS_KEY, _blob, sizeof(_blob)) != sizeof(_blob))
+    {
+        LOG_ERROR("presets could not be written to flash");
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef __PRESETSTORE_H__
+#define __PRESETSTORE_H__
+
+#include "Preferences.h"
+#include "LedController.h"
+
+#define PRESET_COUNT 16
+#define PRESET_NAME_LENGTH 16
+#define PREF_PRESETS_KEY "presets"
+
+// the flash format: a version byte, then one record of explicit fields per preset
+#define PRESET_FORMAT_VERSION 1
+#define PRESET_RECORD_SIZE (1 + PRESET_NAME_LENGTH + 6 + 2)
+
+/**
+ * @brief A complete light state that can be recalled by its id
+ */
+struct LightPreset
+{
+    bool used;
+    char name[PRESET_NAME_LENGTH];
+    bool lightOn;
+    byte red;
+    byte green;
+    byte blue;
+    byte white;
+    byte brightness;
+    LightEffect lightEffect;
+    LightEffect overlayEffect;
+};
+
+/**
+ * @brief Scene presets, persisted in flash and cached in RAM from boot on.
+ * Recalling a preset is a lookup by id, there is nothing to parse.
+ */
+class PresetStore
+{
+private:
+    Preferences *_preferences;
+    LightPreset _presets[PRESET_COUNT];
+    uint8_t _blob[1 + PRESET_COUNT * PRESET_RECORD_SIZE];
+
+    void persist();
+    bool load();
+
+public:
+    PresetStore(Preferences *preferences);
+
+    /**
+     * @brief Load every preset from flash into the RAM cache, must be called once during setup
+     */
+    void setup();
+
+    /**
+     * @brief Get a preset from the cache
+     *
+     * @param id The id of the preset (0 - PRESET_COUNT-1)
+     * @return const LightPreset* The preset or nullptr when the slot is empty
+     */
+    const LightPreset *get(uint8_t id);
+
+    /**
+     * @brief Find a preset by its name
+     *
+     * @param name The name to look for
+     * @return int The id of the preset or -1 when there is none with this name
+     */
+    int find(const char *name);
+
+    /**
+     * @brief Store a state as preset, in RAM and flash
+     *
+     * @param id The slot to use
+     * @param name The name of the preset, only [A-Za-z0-9 _-] is kept
+     * @param state The state to store
+     * @return true The preset was stored
+     */
+    bool save(uint8_t id, const char *name, const LightState *state);
+
+    /**
+     * @brief Clear a slot, in RAM and flash
+     */
+    bool remove(uint8_t id);
+};
+
+#endif // __PRESETSTORE_H__
@@ -1,7 +1,11 @@
+// the unit tests bring their own setup() and loop()
+#ifndef PIO_UNIT_TESTING
+
 extern "C"
 {
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
+#include "freertos/semphr.h"
 }
 
 #include "Arduino.h"
@@ -14,6 +18,14 @@ extern "C"
 #include "AsyncMqttClient.h"
 #include "ESPAsyncWebServer.h"
 #include "AsyncElegantOTA.h"
+#include "MemoryBudget.h"
+#include "LightStateJson.h"
+#include "PresetStore.h"
+#include "CommandRouter.h"
+#include "PowerManager.h"
+#include "Logger.h"
+#include "HomeAssistantDiscovery.h"
+#include "CoreMonitor.h"
 
 #define PREF_APP_KEY "JBLedController"
 #define PREF_INITIALIZED_KEY "initialized"
@@ -22,112 +34,88 @@ Preferences _preferences;
 AsyncMqttClient _mqttClient;
 TimerHandle_t _mqttReconnectTimer;
 TimerHandle_t _wifiReconnectTimer;
+TimerHandle_t _restartTimer;
 
 DeviceUtils _deviceUtils(&_preferences);
 LedController _ledController(&_preferences);
+PresetStore _presetStore(&_preferences);
+CommandRouter _commandRouter(&_ledController, &_presetStore, &_deviceUtils);
+HomeAssistantDiscovery _discovery;
 AsyncWebServer _server(80);
+AsyncWebSocket _webSocket("/ws");
 
-void mqttAutoDiscovery()
-{
-    Serial.println(F("sending MQTT auto discovery for Homeassistant"));
-    StaticJsonDocument<512> jsonDoc;
-
-    String topic = _deviceUtils.GetBaseTopic();
-    String deviceId = _deviceUtils.GetDeviceId();
+#define LATENCY_REPORT_SIZE 512
+#define LATENCY_PUBLISH_INTERVAL 60000
+SemaphoreHandle_t _stateUpdateMutex;
 
-    jsonDoc["~"] = topic;
-    jsonDoc["name"] = deviceId;
-    jsonDoc["unique_id"] = deviceId;
-    jsonDoc["cmd_t"] = F("~/set");
-    jsonDoc["stat_t"] = F("~/state");
-    jsonDoc["schema"] = F("json");
-    jsonDoc["color_mode"] = true;
-    jsonDoc["brightness"] = true;
-    auto supportedColorModesArray = jsonDoc.createNestedArray(F("supported_color_modes"));
-    supportedColorModesArray.add(F("rgbw"));
+// state changes made by the local API are mirrored to MQTT by the network task
+volatile bool _mqttStateUpdatePending = false;
+TaskHandle_t _networkTask = nullptr;
 
-    jsonDoc["effect"] = true;
-    auto effectListArray = jsonDoc.createNestedArray(F("effect_list"));
-    effectListArray.add(F("solid"));
-    effectListArray.add(F("rainbow"));
+void networkTask(void *parameter);
 
-    String discoveryTopic = _deviceUtils.GetHomeAssistantDiscoveryTopic();
-
-    char buffer[512];
-    size_t numberOfBytes = serializeJson(jsonDoc, buffer);
-
-#if DEBUG_MQTT
-
-    serializeJsonPretty(jsonDoc, Serial);
-    Serial.println(F(""));
-
-#endif
+/**
+ * @brief Let the network task publish the state, once the render loop has applied it
+ */
+void requestStateUpdate()
+{
+    _mqttStateUpdatePending = true;
 
-    _mqttClient.publish(discoveryTopic.c_str(), 0, false, buffer, numberOfBytes);
+    if (_networkTask != nullptr)
+        xTaskNotifyGive(_networkTask);
 }
 
 void sendStateUpdate()
 {
-    Serial.println(F("Sending a light state update to MQTT"));
-    StaticJsonDocument<512> jsonDoc;
-    JsonObject jsonObject = jsonDoc.to<JsonObject>();
+    // the static buffers are shared by the MQTT callbacks and the network task
+    xSemaphoreTake(_stateUpdateMutex, portMAX_DELAY);
 
-    auto state = _ledController.getState();
+    LightState state = _ledController.getState();
+    STATIC_MEMORY_STORAGE StaticJsonDocument<JSON_DOCUMENT_SIZE> jsonDoc;
+    LightStateJson::Serialize(&state, jsonDoc);
 
-    if (state->lightOn)
-        jsonDoc[JSON_STATE_KEY] = F("ON");
-    else
-        jsonDoc[JSON_STATE_KEY] = F("OFF");
+    STATIC_MEMORY_STORAGE char buffer[MQTT_PAYLOAD_BUFFER_SIZE];
+    size_t numberOfBytes = serializeJson(jsonDoc, buffer);
 
-    jsonDoc[JSON_BRIGHTNESS_KEY] = state->brightness;
-    jsonDoc[JSON_COLOR_MODE_KEY] = F("rgbw");
-    jsonDoc[JSON_COLOR_KEY][JSON_RED_KEY] = state->red;
-    jsonDoc[JSON_COLOR_KEY][JSON_GREEN_KEY] = state->green;
-    jsonDoc[JSON_COLOR_KEY][JSON_BLUE_KEY] = state->blue;
-    jsonDoc[JSON_COLOR_KEY][JSON_WHITE_KEY] = state->white;
+    const char *topic = _deviceUtils.GetStateTopic();
 
-    if (state->lightEffect == LightEffect::solid)
-    {
-        jsonDoc[JSON_EFFECT_KEY] = "solid";
-    }
-    else if (state->lightEffect == LightEffect::rainbow)
-    {
-        jsonDoc[JSON_EFFECT_KEY] = "rainbow";
-    }
-    else
-    {
-        // Solid as fallback
-        jsonDoc[JSON_EFFECT_KEY] = "solid";
-    }
+    LOG_DEBUG(LOG_MQTT, "sending the state update to: '%s'", topic);
+    LOG_DEBUG_TEXT(LOG_MQTT, "light state: %s", buffer, numberOfBytes);
 
-    char buffer[512];
-    size_t numberOfBytes = serializeJson(jsonDoc, buffer);
+    // TODO: Why is this required to be retained? I dont get it right now.
+    _mqttClient.publish(topic, 0, true, buffer, numberOfBytes);
 
-    String topic = _deviceUtils.GetStateTopic();
+    xSemaphoreGive(_stateUpdateMutex);
+}
 
-    Serial.printf("Sending the state update to: '%s'", topic.c_str());
+/**
+ * @brief Publish the command latency percentiles, when there were new commands since the last time
+ */
+void sendLatencyReport()
+{
+    static uint32_t lastCount = 0;
+    LatencyTracer *tracer = _ledController.getLatencyTracer();
 
-#if DEBUG_MQTT
+    if (tracer->getCount() == lastCount)
+        return;
 
-    Serial.println(F("Light state for MQTT: "));
-    serializeJsonPretty(jsonDoc, Serial);
-    Serial.println(F(""));
+    lastCount = tracer->getCount();
 
-#endif
+    char buffer[LATENCY_REPORT_SIZE];
+    size_t numberOfBytes = tracer->toJson(buffer, sizeof(buffer));
 
-    // TODO: Why is this required to be retained? I dont get it right now.
-    _mqttClient.publish(topic.c_str(), 0, true, buffer, numberOfBytes);
+    _mqttClient.publish(_deviceUtils.GetLatencyTopic(), 0, false, buffer, numberOfBytes);
 }
 
 void connectToWifi()
 {
-    Serial.println(F("Connecting to Wi-Fi..."));
+    LOG_INFO("connecting to Wi-Fi...");
     WiFi.begin(SSID_NAME, SSID_PASSWORD);
 }
 
 void connectToMqtt()
 {
-    Serial.println(F("connecting to MQTT..."));
+    LOG_INFO("connecting to MQTT...");
     _mqttClient.connect();
 }
 
@@ -136,17 +124,18 @@ void wifiEvent(WiFiEvent_t event)
     switch (event)
     {
     case SYSTEM_EVENT_STA_GOT_IP:
-        Serial.println(F("WiFi connected"));
-        Serial.println(F("IP address: "));
-        Serial.println(WiFi.localIP());
+    {
+        IPAddress ip = WiFi.localIP();
+        LOG_INFO("WiFi connected, IP address: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 
         AsyncElegantOTA.begin(&_server); // Start ElegantOTA
         _server.begin();
 
         connectToMqtt();
         break;
+    }
     case SYSTEM_EVENT_STA_DISCONNECTED:
-        Serial.println(F("WiFi lost connection"));
+        LOG_WARN("WiFi lost connection");
         xTimerStop(_mqttReconnectTimer, 0); // ensure we don't reconnect to MQTT while reconnecting to Wi-Fi
         xTimerStart(_wifiReconnectTimer, 0);
         break;
@@ -155,26 +144,20 @@ void wifiEvent(WiFiEvent_t event)
 
 void onMqttConnected(bool sessionPresent)
 {
-    Serial.println(F("Connected to MQTT."));
+    LOG_INFO("connected to MQTT");
+    LOG_DEBUG(LOG_MQTT, "subscribing for light command topic");
 
-#if DEBUG_MQTT
-    Serial.println(F("Subscribing for light command topic"));
-#endif
-
-    _mqttClient.subscribe(_deviceUtils.GetCommandTopic().c_str(), 0);
-
-    delay(500);
+    _mqttClient.subscribe(_deviceUtils.GetCommandTopic(), 0);
+    _mqttClient.subscribe(_deviceUtils.GetPresetTopic(), 0);
 
-    mqttAutoDiscovery();
-
-    delay(500);
-
-    sendStateUpdate();
+    // the discovery and the state are published by the network task, the callback returns right away
+    _discovery.restart();
+    requestStateUpdate();
 }
 
 void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
 {
-    Serial.println(F("Disconnected from MQTT."));
+    LOG_WARN("disconnected from MQTT");
 
     if (WiFi.isConnected())
     {
@@ -184,140 +167,603 @@ void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
 
 void onMqttSubscribe(uint16_t packetId, uint8_t qos)
 {
-#if DEBUG_MQTT
-    Serial.println(F("Subscribe acknowledged."));
-    Serial.print(F("  packetId: "));
-    Serial.println(packetId);
-    Serial.print(F("  qos: "));
-    Serial.println(qos);
-#endif
+    LOG_DEBUG(LOG_MQTT, "subscribe acknowledged, packetId: %u, qos: %u", packetId, qos);
 }
 
 void onMqttUnsubscribe(uint16_t packetId)
 {
-#if DEBUG_MQTT
-    Serial.println(F("Unsubscribe acknowledged."));
-    Serial.print(F("  packetId: "));
-    Serial.println(packetId);
-#endif
+    LOG_DEBUG(LOG_MQTT, "unsubscribe acknowledged, packetId: %u", packetId);
 }
 
-void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total)
+/**
+ * @brief Send the current state to every connected WebSocket client
+ */
+void notifyLocalClients()
 {
-    Serial.printf("MQTT message at topic: '%s' received\n", topic);
+    if (_webSocket.count() == 0)
+        return;
 
-    StaticJsonDocument<512> jsonDoc;
-    deserializeJson(jsonDoc, payload, len);
+    LightState state = _ledController.getState();
+    STATIC_MEMORY_STORAGE StaticJsonDocument<JSON_DOCUMENT_SIZE> jsonDoc;
+    LightStateJson::Serialize(&state, jsonDoc);
 
-    String commandTopic = _deviceUtils.GetCommandTopic();
+    STATIC_MEMORY_STORAGE char buffer[MQTT_PAYLOAD_BUFFER_SIZE];
+    size_t numberOfBytes = serializeJson(jsonDoc, buffer);
 
-#if DEBUG_MQTT
-    serializeJsonPretty(jsonDoc, Serial);
-    Serial.println(F(""));
-    Serial.printf("CommandTopic: '%s'", commandTopic.c_str());
-#endif
+    _webSocket.textAll(buffer, numberOfBytes);
+}
+
+/**
+ * @brief Apply a command from the local API, the state gets mirrored to MQTT afterwards by the network task
+ */
+bool applyLocalCommand(const char *payload, size_t len, CommandTrace *trace)
+{
+    if (!_commandRouter.applyCommand(payload, len, trace))
+        return false;
+
+    notifyLocalClients();
+    requestStateUpdate();
+
+    return true;
+}
+
+/**
+ * @brief Recall a preset, the state is published by the network task once it has been applied
+ *
+ * @return true The preset exists
+ */
+bool recallPreset(uint8_t id, CommandTrace *trace)
+{
+    if (!_commandRouter.recallPreset(id, trace))
+        return false;
+
+    requestStateUpdate();
+
+    return true;
+}
+
+void sendStateResponse(AsyncWebServerRequest *request, int code)
+{
+    LightState state = _ledController.getState();
+    STATIC_MEMORY_STORAGE StaticJsonDocument<JSON_DOCUMENT_SIZE> jsonDoc;
+    LightStateJson::Serialize(&state, jsonDoc);
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->setCode(code);
+    serializeJson(jsonDoc, *response);
+    request->send(response);
+}
+
+// The body handler and the request handler of a POST run on the AsyncTCP task, but the bodies of
+// concurrent requests interleave. Each request gets its own slot, the request pointer is the key.
+#define LOCAL_REQUEST_SLOTS 2
+
+struct LocalCommandSlot
+{
+    AsyncWebServerRequest *request;
+    CommandTrace trace;
+    int status;
+    char buffer[MQTT_PAYLOAD_BUFFER_SIZE];
+};
 
-    String commandTopic = _deviceUtils.GetCommandTopic();
-    if (strcmp(topic, commandTopic.c_str()) == 0)
+LocalCommandSlot _localCommandSlots[LOCAL_REQUEST_SLOTS];
+
+LocalCommandSlot *findLocalCommandSlot(AsyncWebServerRequest *request)
+{
+    for (uint8_t i = 0; i < LOCAL_REQUEST_SLOTS; i++)
     {
-#if DEBUG_MQTT
-        Serial.printf("\nthere was a mqtt message at '%s'\n", commandTopic.c_str());
-#endif
-        LightStateUpdate stateUpdate = LightStateUpdate();
+        if (_localCommandSlots[i].request == request)
+            return &_localCommandSlots[i];
+    }
 
-        if (jsonDoc.containsKey(JSON_STATE_KEY))
-        {
-#if DEBUG_MQTT
-            Serial.println(F("Message contains state information"));
-#endif
-            stateUpdate.lightOnPresent = true;
+    return nullptr;
+}
 
-            auto state = jsonDoc[JSON_STATE_KEY];
-            if (strcmp(state, "ON") == 0)
-                stateUpdate.lightOn = true;
-            else if (strcmp(state, "OFF") == 0)
-                stateUpdate.lightOn = false;
-        }
+void releaseLocalCommandSlot(AsyncWebServerRequest *request)
+{
+    LocalCommandSlot *slot = findLocalCommandSlot(request);
+
+    if (slot != nullptr)
+        slot->request = nullptr;
+}
 
-        if (jsonDoc.containsKey(JSON_BRIGHTNESS_KEY))
+/**
+ * @brief Take a free slot for a request, it is given back when the request has been answered or the client is gone
+ *
+ * @return LocalCommandSlot* The slot or nullptr when every slot is in use
+ */
+LocalCommandSlot *claimLocalCommandSlot(AsyncWebServerRequest *request)
+{
+    LocalCommandSlot *slot = findLocalCommandSlot(nullptr);
+
+    if (slot == nullptr)
+        return nullptr;
+
+    slot->request = request;
+    slot->trace = CommandTrace();
+    slot->status = 400;
+
+    // a client that drops the connection in the middle of the body never reaches the request handler
+    request->onDisconnect([request]()
+                          { releaseLocalCommandSlot(request); });
+
+    return slot;
+}
+
+void onLocalCommandBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    LocalCommandSlot *slot = index == 0 ? claimLocalCommandSlot(request) : findLocalCommandSlot(request);
+
+    if (slot == nullptr)
+        return;
+
+    if (index == 0)
+        slot->trace.receivedMicros = micros();
+
+    if (total > sizeof(slot->buffer))
+    {
+        slot->status = 413;
+        return;
+    }
+
+    memcpy(slot->buffer + index, data, len);
+
+    if (index + len == total)
+    {
+        MemoryBudget::HotPathScope hotPath;
+        slot->status = applyLocalCommand(slot->buffer, total, &slot->trace) ? 200 : 400;
+    }
+}
+
+void onLocalCommandRequest(AsyncWebServerRequest *request)
+{
+    LocalCommandSlot *slot = findLocalCommandSlot(request);
+    int status = 400;
+
+    if (slot != nullptr)
+        status = slot->status;
+    else if (request->contentLength() > 0)
+        status = 503; // every slot was taken by other requests
+
+    releaseLocalCommandSlot(request);
+
+    if (status == 200)
+        sendStateResponse(request, 200);
+    else if (status == 413)
+        request->send(status, "application/json", "{\"error\":\"payload too large\"}");
+    else if (status == 503)
+        request->send(status, "application/json", "{\"error\":\"busy\"}");
+    else
+        request->send(status, "application/json", "{\"error\":\"invalid command\"}");
+}
+
+/**
+ * @brief Get the preset a request refers to, by the "id" or the "name" parameter
+ *
+ * @return int The id of the preset or -1
+ */
+int presetIdFromRequest(AsyncWebServerRequest *request)
+{
+    if (request->hasParam("id"))
+    {
+        const String &value = request->getParam("id")->value();
+        uint8_t id;
+
+        if (CommandRouter::ParsePresetId(value.c_str(), value.length(), &id) && id < PRESET_COUNT)
+            return id;
+
+        return -1;
+    }
+
+    if (request->hasParam("name"))
+        return _presetStore.find(request->getParam("name")->value().c_str());
+
+    return -1;
+}
+
+void onPresetRecallRequest(AsyncWebServerRequest *request)
+{
+    CommandTrace trace;
+    trace.receivedMicros = micros();
+    int id = presetIdFromRequest(request);
+
+    if (id < 0 || !recallPreset(id, &trace))
+    {
+        request->send(404, "application/json", "{\"error\":\"unknown preset\"}");
+        return;
+    }
+
+    request->send(204);
+}
+
+void onPresetSaveRequest(AsyncWebServerRequest *request)
+{
+    int id = presetIdFromRequest(request);
+    String name = request->hasParam("name") ? request->getParam("name")->value() : String("preset");
+    LightState state = _ledController.getState();
+
+    if (id < 0 && request->hasParam("name") && !request->hasParam("id"))
+    {
+        // a new name, take the first free slot
+        for (uint8_t slot = 0; slot < PRESET_COUNT && id < 0; slot++)
         {
-#if DEBUG_MQTT
-            Serial.println(F("Message contains brightness information"));
-#endif
-            stateUpdate.brightnessPresent = true;
-            stateUpdate.brightness = jsonDoc[JSON_BRIGHTNESS_KEY];
+            if (_presetStore.get(slot) == nullptr)
+                id = slot;
         }
+    }
 
-        if (jsonDoc.containsKey(JSON_COLOR_KEY))
-        {
-#if DEBUG_MQTT
-            Serial.println(F("Message contains color information"));
-#endif
-            JsonVariant colorVariant = jsonDoc[JSON_COLOR_KEY];
+    if (id < 0 || !_presetStore.save(id, name.c_str(), &state))
+    {
+        request->send(400, "application/json", "{\"error\":\"no preset slot\"}");
+        return;
+    }
 
-            if (colorVariant.containsKey(JSON_RED_KEY))
-            {
-#if DEBUG_MQTT
-                Serial.println(F("Message contains color red information"));
-#endif
-                stateUpdate.redPresent = true;
-                stateUpdate.red = colorVariant[JSON_RED_KEY];
-            }
-
-            if (colorVariant.containsKey(JSON_GREEN_KEY))
-            {
-#if DEBUG_MQTT
-                Serial.println(F("Message contains color green information"));
-#endif
-                stateUpdate.greenPresent = true;
-                stateUpdate.green = colorVariant[JSON_GREEN_KEY];
-            }
-
-            if (colorVariant.containsKey(JSON_BLUE_KEY))
-            {
-#if DEBUG_MQTT
-                Serial.println(F("Message contains color blue information"));
-#endif
-                stateUpdate.bluePresent = true;
-                stateUpdate.blue = colorVariant[JSON_BLUE_KEY];
-            }
-
-            if (colorVariant.containsKey(JSON_WHITE_KEY))
-            {
-#if DEBUG_MQTT
-                Serial.println(F("Message contains color white information"));
-#endif
-                stateUpdate.whitePresent = true;
-                stateUpdate.white = colorVariant[JSON_WHITE_KEY];
-            }
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "{\"id\":%d}", id);
+    request->send(200, "application/json", buffer);
+}
+
+void onPresetDeleteRequest(AsyncWebServerRequest *request)
+{
+    int id = presetIdFromRequest(request);
+
+    if (id < 0 || !_presetStore.remove(id))
+    {
+        request->send(404, "application/json", "{\"error\":\"unknown preset\"}");
+        return;
+    }
+
+    request->send(204);
+}
+
+void sendPresetsResponse(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("[");
+
+    bool first = true;
+    for (uint8_t id = 0; id < PRESET_COUNT; id++)
+    {
+        const LightPreset *preset = _presetStore.get(id);
+        if (preset == nullptr)
+            continue;
+
+        response->printf("%s{\"id\":%u,\"name\":\"%s\",\"effect\":\"%s\"}",
+                         first ? "" : ",", id, preset->name, LedUtils::EffectNameFromEnum(preset->lightEffect));
+        first = false;
+    }
+
+    response->print("]");
+    request->send(response);
+}
+
+void sendLayoutResponse(AsyncWebServerRequest *request, const LayoutConfig *config)
+{
+    char buffer[192];
+    snprintf(buffer, sizeof(buffer),
+             "{\"width\":%u,\"height\":%u,\"rotation\":%u,\"serpentine\":%s,\"mirror_x\":%s,\"mirror_y\":%s,\"custom\":%s}",
+             config->width, config->height, config->rotation,
+             config->serpentine ? "true" : "false",
+             config->mirrorX ? "true" : "false",
+             config->mirrorY ? "true" : "false",
+             config->custom ? "true" : "false");
+
+    request->send(200, "application/json", buffer);
+}
+
+/**
+ * @brief Build a layout from the current one and the parameters of a request
+ */
+LayoutConfig layoutFromRequest(AsyncWebServerRequest *request)
+{
+    LayoutConfig config = *_ledController.getLayout()->getConfig();
+
+    if (request->hasParam("width"))
+        config.width = request->getParam("width")->value().toInt();
+    if (request->hasParam("height"))
+        config.height = request->getParam("height")->value().toInt();
+    if (request->hasParam("rotation"))
+        config.rotation = request->getParam("rotation")->value().toInt();
+    if (request->hasParam("serpentine"))
+        config.serpentine = request->getParam("serpentine")->value().toInt() != 0;
+    if (request->hasParam("mirror_x"))
+        config.mirrorX = request->getParam("mirror_x")->value().toInt() != 0;
+    if (request->hasParam("mirror_y"))
+        config.mirrorY = request->getParam("mirror_y")->value().toInt() != 0;
+
+    return config;
+}
+
+void applyLayout(AsyncWebServerRequest *request, LayoutConfig *config)
+{
+    LedLayout *layout = _ledController.getLayout();
+
+    if (!layout->isValid(config))
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid layout\"}");
+        return;
+    }
+
+    layout->persist(config);
+    _ledController.setLayout(config);
+
+    sendLayoutResponse(request, config);
+}
+
+void onLayoutRequest(AsyncWebServerRequest *request)
+{
+    LayoutConfig config = layoutFromRequest(request);
+    config.custom = false;
+
+    applyLayout(request, &config);
+}
+
+// the custom table is uploaded as body into the staging table of the layout, the request is the owner
+void onLayoutMapBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    LedLayout *layout = _ledController.getLayout();
+
+    if (index == 0)
+    {
+        if (!layout->beginCustomMap(request))
+            return;
+
+        request->onDisconnect([request]()
+                              { _ledController.getLayout()->abortCustomMap(request); });
+    }
+
+    layout->writeCustomMap(request, data, index, len);
+}
+
+void onLayoutMapRequest(AsyncWebServerRequest *request)
+{
+    LayoutConfig config = layoutFromRequest(request);
+    config.custom = true;
+
+    // the table in use stays untouched unless the whole upload is valid
+    if (!_ledController.getLayout()->commitCustomMap(request, &config))
+    {
+        request->send(400, "application/json", "{\"error\":\"the map needs width * height 16 bit indices (one upload at a time)\"}");
+        return;
+    }
+
+    applyLayout(request, &config);
+}
+
+void sendDriverResponse(AsyncWebServerRequest *request)
+{
+    LedDriver *driver = _ledController.getExternalDriver();
+    uint32_t showMicros = _ledController.getShowMicros();
+
+    char buffer[192];
+    snprintf(buffer, sizeof(buffer),
+             "{\"chipset\":\"%s\",\"pixels\":%u,\"frame_bytes\":%u,\"wire_us\":%u,\"show_us\":%u,\"max_fps\":%u}",
+             LedDriver::ChipsetName(driver->chipset()),
+             driver->numPixels(),
+             (unsigned)driver->frameBytes(),
+             (unsigned)driver->wireMicros(),
+             (unsigned)showMicros,
+             (unsigned)(showMicros > 0 ? 1000000 / showMicros : 0));
+
+    request->send(200, "application/json", buffer);
+}
+
+/**
+ * @brief Select the chipset of the external strip, the buffers are sized at boot, so the controller restarts
+ */
+void onDriverRequest(AsyncWebServerRequest *request)
+{
+    LedChipset chipset = LedChipset::chipsetCount;
+
+    if (request->hasParam("chipset"))
+        chipset = LedDriver::ChipsetFromName(request->getParam("chipset")->value().c_str());
+
+    if (chipset == LedChipset::chipsetCount)
+    {
+        request->send(400, "application/json", "{\"error\":\"unknown chipset\"}");
+        return;
+    }
+
+    _preferences.putUChar(PREF_LED_CHIPSET_KEY, chipset);
+    request->send(202, "application/json", "{\"restarting\":true}");
+
+    xTimerStart(_restartTimer, 0);
+}
+
+void sendLogResponse(AsyncWebServerRequest *request)
+{
+    uint8_t categories = Logger::getCategories();
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "{\"level\":\"%s\",\"general\":%s,\"mqtt\":%s,\"light\":%s,\"dropped\":%u}",
+             Logger::LevelName(Logger::getLevel()),
+             (categories & LOG_GENERAL) ? "true" : "false",
+             (categories & LOG_MQTT) ? "true" : "false",
+             (categories & LOG_LIGHT) ? "true" : "false",
+             (unsigned)Logger::getDropped());
+
+    request->send(200, "application/json", buffer);
+}
+
+/**
+ * @brief Change the log level and switch the debug categories on or off, without a new firmware
+ */
+void onLogRequest(AsyncWebServerRequest *request)
+{
+    if (request->hasParam("level"))
+    {
+        uint8_t level = Logger::LevelFromName(request->getParam("level")->value().c_str());
+
+        if (level == 0)
+        {
+            request->send(400, "application/json", "{\"error\":\"unknown level\"}");
+            return;
         }
 
-        if (jsonDoc.containsKey(JSON_EFFECT_KEY))
+        Logger::setLevel(level);
+    }
+
+    const char *names[] = {"general", "mqtt", "light"};
+    const uint8_t masks[] = {LOG_GENERAL, LOG_MQTT, LOG_LIGHT};
+    uint8_t categories = Logger::getCategories();
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        if (!request->hasParam(names[i]))
+            continue;
+
+        if (request->getParam(names[i])->value().toInt() != 0)
+            categories |= masks[i];
+        else
+            categories &= ~masks[i];
+    }
+
+    Logger::setCategories(categories);
+    sendLogResponse(request);
+}
+
+void sendLatencyResponse(AsyncWebServerRequest *request)
+{
+    char buffer[LATENCY_REPORT_SIZE];
+    _ledController.getLatencyTracer()->toJson(buffer, sizeof(buffer));
+
+    request->send(200, "application/json", buffer);
+}
+
+void onWebSocketEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    CommandTrace trace;
+    trace.receivedMicros = micros();
+
+    switch (type)
+    {
+    case WS_EVT_CONNECT:
+    {
+        // greet the new client with the current state
+        LightState state = _ledController.getState();
+        STATIC_MEMORY_STORAGE StaticJsonDocument<JSON_DOCUMENT_SIZE> jsonDoc;
+        LightStateJson::Serialize(&state, jsonDoc);
+
+        STATIC_MEMORY_STORAGE char buffer[MQTT_PAYLOAD_BUFFER_SIZE];
+        size_t numberOfBytes = serializeJson(jsonDoc, buffer);
+        client->text(buffer, numberOfBytes);
+        break;
+    }
+    case WS_EVT_DATA:
+    {
+        AwsFrameInfo *info = reinterpret_cast<AwsFrameInfo *>(arg);
+
+        // a single binary byte recalls a preset
+        if (info->final && info->index == 0 && info->len == 1 && info->opcode == WS_BINARY)
         {
-#if DEBUG_MQTT
-            Serial.println(F("Message contains effect information"));
-#endif
-            stateUpdate.lightEffectPresent = true;
-
-            String effectString = jsonDoc[JSON_EFFECT_KEY].as<String>();
-
-            if (effectString.equals("solid"))
-            {
-                stateUpdate.lightEffect = LightEffect::solid;
-            }
-            else if (effectString.equals("rainbow"))
-            {
-                stateUpdate.lightEffect = LightEffect::rainbow;
-            }
-            else
-            {
-                stateUpdate.lightEffect = unknown;
-                stateUpdate.lightEffectPresent = false;
-                Serial.printf("light effect: '%s' is not supported\n", effectString.c_str());
-            }
+            recallPreset(data[0], &trace);
+        }
+        // commands are small, only single frame text messages are accepted
+        else if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT)
+        {
+            MemoryBudget::HotPathScope hotPath;
+            applyLocalCommand(reinterpret_cast<const char *>(data), len, &trace);
         }
+        else
+        {
+            client->text("{\"error\":\"fragmented messages are not supported\"}");
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Direct control on the local network, bypassing the MQTT broker
+ *
+ * GET  /api/state    the current state
+ * POST /api/state    a command in the MQTT state schema, answered with the new state
+ * GET  /api/latency  percentiles of every stage from receiving a command to show()
+ * GET  /api/power    CPU clock and render utilization per activity (off, static, animated)
+ * GET  /api/cores    the load per core and how late the animation frames start
+ * GET  /api/driver   the chipset of the external strip and its wire throughput
+ * POST /api/driver?chipset=apa102  ws2812, sk6812, apa102 or sk9822, restarts the controller
+ * GET  /api/layout   the LED layout
+ * POST /api/layout?width=16&height=10&serpentine=1&rotation=90&mirror_x=0&mirror_y=0
+ * POST /api/layout/map?width=16&height=10  a custom table, width * height physical indices (uint16 LE) as body
+ * GET  /api/log      the log level and the enabled debug categories
+ * POST /api/log?level=debug&general=1&mqtt=1&light=0  error, warn, info or debug, compiled out levels stay silent
+ * GET  /api/presets  the stored presets
+ * POST /api/presets/recall?id=3 (or ?name=...)
+ * POST /api/presets/save?id=3&name=evening  stores the current state
+ * POST /api/presets/delete?id=3
+ * WS   /ws           commands in (a single binary byte recalls a preset), state updates out
+ */
+void initLocalApi()
+{
+    _server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request)
+               { sendStateResponse(request, 200); });
+
+    _server.on("/api/state", HTTP_POST, onLocalCommandRequest, nullptr, onLocalCommandBody);
+
+    _server.on("/api/latency", HTTP_GET, sendLatencyResponse);
+
+    _server.on("/api/power", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+                   AsyncResponseStream *response = request->beginResponseStream("application/json");
+                   _ledController.getPowerManager()->report(*response);
+                   request->send(response); });
+
+    _server.on("/api/log", HTTP_GET, sendLogResponse);
+    _server.on("/api/log", HTTP_POST, onLogRequest);
+
+    _server.on("/api/cores", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+                   AsyncResponseStream *response = request->beginResponseStream("application/json");
+                   response->print("{\"cpu\":");
+                   CoreMonitor::report(*response);
+                   response->print(",\"frames\":");
+                   _ledController.getFrameStats()->report(*response);
+                   response->print("}");
+                   request->send(response); });
+
+    _server.on("/api/driver", HTTP_GET, sendDriverResponse);
+    _server.on("/api/driver", HTTP_POST, onDriverRequest);
+
+    // "/api/layout" would match "/api/layout/map" as well, the more specific handler goes first
+    _server.on("/api/layout/map", HTTP_POST, onLayoutMapRequest, nullptr, onLayoutMapBody);
+    _server.on("/api/layout", HTTP_GET, [](AsyncWebServerRequest *request)
+               { sendLayoutResponse(request, _ledController.getLayout()->getConfig()); });
+    _server.on("/api/layout", HTTP_POST, onLayoutRequest);
+
+    _server.on("/api/presets", HTTP_GET, sendPresetsResponse);
+    _server.on("/api/presets/recall", HTTP_POST, onPresetRecallRequest);
+    _server.on("/api/presets/save", HTTP_POST, onPresetSaveRequest);
+    _server.on("/api/presets/delete", HTTP_POST, onPresetDeleteRequest);
+
+    _webSocket.onEvent(onWebSocketEvent);
+    _server.addHandler(&_webSocket);
+}
+
+void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total)
+{
+    MemoryBudget::HotPathScope hotPath;
+    CommandTrace trace;
+    trace.receivedMicros = micros();
 
-        _ledController.setState(stateUpdate);
+    LOG_DEBUG_TEXT(LOG_MQTT, "MQTT message at topic: '%s' received", topic);
+
+    bool applied;
+    CommandTopic commandTopic = _commandRouter.route(topic, payload, len, &trace, &applied);
+
+    if (commandTopic == CommandTopic::topicCommand)
+    {
+        notifyLocalClients();
+    }
+    else if (commandTopic == CommandTopic::topicPreset)
+    {
+        // the state is published once the preset has been applied
+        if (applied)
+            requestStateUpdate();
+
+        return;
     }
 
     sendStateUpdate();
@@ -325,11 +771,7 @@ void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties
 
 void onMqttPublish(uint16_t packetId)
 {
-#if DEBUG_MQTT
-    Serial.println(F("Publish acknowledged."));
-    Serial.print(F("  packetId: "));
-    Serial.println(packetId);
-#endif
+    LOG_DEBUG(LOG_MQTT, "publish acknowledged, packetId: %u", packetId);
 }
 
 void init_preferences()
@@ -337,7 +779,7 @@ void init_preferences()
     // init the _preferences
     if (!_preferences.begin(PREF_APP_KEY))
     {
-        Serial.println(F("_preferences could not be set up"));
+        LOG_ERROR("_preferences could not be set up");
 
         delay(5000);
         esp_restart();
@@ -351,14 +793,14 @@ void initConfig()
     if (isInitialized)
     {
         // this seems NOT to be the first boot
-        Serial.println(F("not the first boot"));
+        LOG_INFO("not the first boot");
 
         String deviceId = _preferences.getString(PREF_DEVICE_NAME_KEY);
     }
     else
     {
         // this seems to be the first boot
-        Serial.println(F("first boot"));
+        LOG_INFO("first boot");
 
         // generate a device id..
         String deviceId = _deviceUtils.GenerateDeviceId();
@@ -366,9 +808,7 @@ void initConfig()
         // and store it
         _preferences.putString(PREF_DEVICE_NAME_KEY, deviceId.c_str());
 
-#if DEBUG
-        Serial.println(deviceId.c_str());
-#endif
+        LOG_DEBUG_TEXT(LOG_GENERAL, "device id: %s", deviceId.c_str());
 
         // initialization is done,
         // set the flag in _preferences to show, that we are properly initialized
@@ -378,46 +818,49 @@ void initConfig()
 
 void initWifi()
 {
-    Serial.println(F("Init: WIFI"));
+    LOG_INFO("Init: WIFI");
 
     WiFi.mode(WIFI_STA);
     WiFi.begin(SSID_NAME, SSID_PASSWORD);
 
-#if DEBUG
-    Serial.println();
-    Serial.print(F("Connecting to: "));
-    Serial.println(SSID_NAME);
-#endif
+    LOG_DEBUG(LOG_GENERAL, "connecting to: %s", SSID_NAME);
 
     while (WiFi.status() != WL_CONNECTED)
     {
         delay(500);
-        Serial.print(F("."));
     }
 
     randomSeed(micros());
 
-#if DEBUG
-    Serial.println(F(""));
-    Serial.println(F("WiFi connected"));
-    Serial.println(F("IP address: "));
-    Serial.println(WiFi.localIP());
-#endif
-    Serial.println(F("End-Init: WIFI"));
+    IPAddress ip = WiFi.localIP();
+    LOG_DEBUG(LOG_GENERAL, "WiFi connected, IP address: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    LOG_INFO("End-Init: WIFI");
 }
 
 void setup()
 {
     // setup the serial port
     Serial.begin(115200);
+    Logger::setup();
 
     // safety delay
     delay(500);
 
     init_preferences();
     initConfig();
+    _deviceUtils.Init();
+
+#if STATIC_MEMORY
+    // state update, command, local notify, local state response, websocket greeting
+    MemoryBudget::reserve(MemorySubsystem::jsonDocuments, 5 * sizeof(StaticJsonDocument<JSON_DOCUMENT_SIZE>));
+    MemoryBudget::reserve(MemorySubsystem::mqttBuffers, 3 * MQTT_PAYLOAD_BUFFER_SIZE);
+#endif
+    MemoryBudget::reserve(MemorySubsystem::mqttBuffers, sizeof(_localCommandSlots));
+
+    _stateUpdateMutex = xSemaphoreCreateMutex();
 
     _mqttReconnectTimer = xTimerCreate("mqttTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToMqtt));
+    _restartTimer = xTimerCreate("restartTimer", pdMS_TO_TICKS(500), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(esp_restart));
     _wifiReconnectTimer = xTimerCreate("wifiTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToWifi));
 
     WiFi.onEvent(wifiEvent);
@@ -433,11 +876,99 @@ void setup()
     _server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
                { request->send(200, "text/plain", "Hi! I am an LED-Controller \n\n OTA should be enabled for this one at: 'http://<IPAddress>/update'"); });
 
+    initLocalApi();
+
+    _server.on("/memory", HTTP_GET, [](AsyncWebServerRequest *request)
+               {
+                   AsyncResponseStream *response = request->beginResponseStream("text/plain");
+                   MemoryBudget::report(*response);
+                   request->send(response); });
+
     connectToWifi();
     _ledController.setup();
+    _presetStore.setup();
+
+    // the controller drives a single strip, it is announced as one light
+    _discovery.addLight(_deviceUtils.GetHomeAssistantDiscoveryTopic(), _deviceUtils.GetBaseTopic(), _deviceUtils.GetDeviceId(), _deviceUtils.GetDeviceId());
+    _discovery.setup(_deviceUtils.GetDeviceId());
+
+    // the render loop keeps the Arduino loop task, the network side gets its own task (and stack) on NETWORK_CORE
+    CoreMonitor::setup();
+    xTaskCreatePinnedToCore(networkTask, "network", 4096, nullptr, 1, &_networkTask, NETWORK_CORE);
+
+    // the budget is sealed by the network task, once the first connection is up
+}
+
+/**
+ * @brief Everything that talks to the network on behalf of the main loop: the discovery, the
+ * mirrored state, the latency report and the WebSocket housekeeping. It runs pinned to
+ * NETWORK_CORE, the render loop never waits for it.
+ */
+void networkTask(void *parameter)
+{
+    unsigned long nextLatencyReport = LATENCY_PUBLISH_INTERVAL;
+    unsigned long nextHousekeeping = 0;
+    bool sealed = false;
+
+    while (true)
+    {
+        // one entity per pass, the state follows once Home Assistant knows every entity
+        if (_discovery.isPending() && _mqttClient.connected())
+        {
+            _discovery.publishNext(&_mqttClient);
+        }
+
+        // wait until the frame with the new state has been rendered
+        if (_mqttStateUpdatePending && !_discovery.isPending() && !_ledController.hasPendingState() && _mqttClient.connected())
+        {
+            _mqttStateUpdatePending = false;
+            sendStateUpdate();
+        }
+
+        // Wi-Fi, the MQTT client and AsyncTCP allocate while they connect, that is part of the boot.
+        // From the first complete connection on (discovery and state sent) every buffer has to exist already.
+        if (!sealed && _mqttClient.connected() && !_discovery.isPending() && !_mqttStateUpdatePending)
+        {
+            sealed = true;
+            MemoryBudget::seal();
+
+            if (Logger::isEnabled(LOG_LEVEL_DEBUG, LOG_GENERAL))
+                MemoryBudget::report(Serial);
+        }
+
+        if (millis() >= nextLatencyReport && _mqttClient.connected())
+        {
+            nextLatencyReport = millis() + LATENCY_PUBLISH_INTERVAL;
+            sendLatencyReport();
+        }
+
+        if (millis() >= nextHousekeeping)
+        {
+            nextHousekeeping = millis() + 1000;
+            _webSocket.cleanupClients();
+            CoreMonitor::sample();
+        }
+
+        // poll while something waits for the render side, otherwise sleep until the next tick or a request.
+        // Without a broker nothing can be sent, the connect callback notifies the task.
+        unsigned long now = millis();
+        uint32_t delayMillis = nextHousekeeping > now ? nextHousekeeping - now : 0;
+
+        if ((_mqttStateUpdatePending || _discovery.isPending()) && _mqttClient.connected())
+            delayMillis = min(delayMillis, (uint32_t)20);
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(delayMillis));
+    }
 }
 
 void loop()
 {
     _ledController.loop();
-}
\ No newline at end of file
+
+    // sleep until the next frame is due, a command wakes the task up earlier
+    uint32_t delayMillis = _ledController.getFrameDelay();
+
+    ulTaskNotifyTake(pdTRUE, delayMillis == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(delayMillis));
+}
+
+#endif // PIO_UNIT_TESTING
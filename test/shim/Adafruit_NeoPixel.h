@@ -0,0 +1,154 @@
+#ifndef __SHIM_ADAFRUIT_NEOPIXEL_H__
+#define __SHIM_ADAFRUIT_NEOPIXEL_H__
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+// the byte order encoding of the library: offsets of white, red, green and blue
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_GRBW ((3 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+typedef uint16_t neoPixelType;
+
+/**
+ * @brief Adafruit_NeoPixel with the same pixel buffer and brightness math as the library,
+ * show() records the buffer per pin instead of sending it
+ */
+class Adafruit_NeoPixel
+{
+private:
+    std::vector<uint8_t> _pixels;
+    uint16_t _numLeds = 0;
+    int16_t _pin = -1;
+    uint8_t _brightness = 0;    // stored + 1, 0 is full brightness
+    uint8_t _rOffset = 1;
+    uint8_t _gOffset = 0;
+    uint8_t _bOffset = 2;
+    uint8_t _wOffset = 1;
+
+    uint8_t bytesPerPixel() const { return _wOffset == _rOffset ? 3 : 4; }
+
+public:
+    /**
+     * @brief The last frame every pin has shown
+     */
+    static inline std::map<int16_t, std::vector<uint8_t>> Wire;
+    static inline std::map<int16_t, uint32_t> ShowCount;
+
+    Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800)
+    {
+        updateType(type);
+        updateLength(n);
+        setPin(pin);
+    }
+
+    Adafruit_NeoPixel() {}
+
+    void updateType(neoPixelType type)
+    {
+        bool threeBytes = bytesPerPixel() == 3;
+
+        _wOffset = (type >> 6) & 0b11;
+        _rOffset = (type >> 4) & 0b11;
+        _gOffset = (type >> 2) & 0b11;
+        _bOffset = type & 0b11;
+
+        if (threeBytes != (bytesPerPixel() == 3))
+            updateLength(_numLeds);
+    }
+
+    void updateLength(uint16_t n)
+    {
+        _numLeds = n;
+        _pixels.assign((size_t)n * bytesPerPixel(), 0);
+    }
+
+    void setPin(int16_t pin) { _pin = pin; }
+    void begin() {}
+
+    void show()
+    {
+        Wire[_pin] = _pixels;
+        ShowCount[_pin]++;
+    }
+
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0)
+    {
+        if (n >= _numLeds)
+            return;
+
+        if (_brightness)
+        {
+            r = (r * _brightness) >> 8;
+            g = (g * _brightness) >> 8;
+            b = (b * _brightness) >> 8;
+            w = (w * _brightness) >> 8;
+        }
+
+        uint8_t *p = &_pixels[(size_t)n * bytesPerPixel()];
+
+        if (bytesPerPixel() == 4)
+            p[_wOffset] = w;
+
+        p[_rOffset] = r;
+        p[_gOffset] = g;
+        p[_bOffset] = b;
+    }
+
+    void setPixelColor(uint16_t n, uint32_t c)
+    {
+        setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c, (uint8_t)(c >> 24));
+    }
+
+    void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0)
+    {
+        uint16_t end = count == 0 ? _numLeds : std::min<uint16_t>(first + count, _numLeds);
+
+        for (uint16_t i = first; i < end; i++)
+            setPixelColor(i, c);
+    }
+
+    void setBrightness(uint8_t b)
+    {
+        uint8_t newBrightness = b + 1;
+
+        if (newBrightness == _brightness)
+            return;
+
+        // the library scales the pixels that are already set, with the same rounding
+        uint8_t oldBrightness = _brightness - 1;
+        uint16_t scale;
+
+        if (oldBrightness == 0)
+            scale = 0;
+        else if (b == 255)
+            scale = 65535 / oldBrightness;
+        else
+            scale = (((uint16_t)newBrightness << 8) - 1) / oldBrightness;
+
+        for (uint8_t &c : _pixels)
+            c = (c * scale) >> 8;
+
+        _brightness = newBrightness;
+    }
+
+    uint8_t getBrightness() const { return _brightness - 1; }
+    void clear() { std::fill(_pixels.begin(), _pixels.end(), 0); }
+    uint16_t numPixels() const { return _numLeds; }
+    uint8_t *getPixels() { return _pixels.data(); }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t w)
+    {
+        return ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+};
+
+#endif // __SHIM_ADAFRUIT_NEOPIXEL_H__
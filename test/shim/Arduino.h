@@ -0,0 +1,182 @@
+#ifndef __SHIM_ARDUINO_H__
+#define __SHIM_ARDUINO_H__
+
+// The part of the Arduino core (and of FreeRTOS) the controller sources use, for the native
+// test environment. There is no scheduler: tasks are not started and notifications are dropped.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cctype>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+typedef uint8_t byte;
+
+#define F(text) (text)
+#define PROGMEM
+
+/**
+ * @brief The clock of the host, tests can move it forward to reach the next frame without waiting
+ */
+class ShimClock
+{
+public:
+    static uint64_t nowMicros()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + _offsetMicros;
+    }
+
+    static void advanceMicros(uint64_t micros) { _offsetMicros += micros; }
+    static void advanceMillis(uint32_t millis) { advanceMicros((uint64_t)millis * 1000); }
+
+private:
+    static inline const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    static inline uint64_t _offsetMicros = 0;
+};
+
+inline unsigned long micros() { return (unsigned long)(uint32_t)ShimClock::nowMicros(); }
+inline unsigned long millis() { return (unsigned long)(uint32_t)(ShimClock::nowMicros() / 1000); }
+inline void delay(unsigned long ms) { ShimClock::advanceMillis(ms); }
+
+template <class T>
+T constrain(T value, T low, T high)
+{
+    return value < low ? low : (value > high ? high : value);
+}
+
+using std::max;
+using std::min;
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            write(buffer[i]);
+
+        return size;
+    }
+
+    size_t print(const char *text) { return write(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+    size_t println(const char *text = "") { return print(text) + write('\n'); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+
+        return print(buffer);
+    }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+    using Print::write;
+};
+
+inline HardwareSerial Serial;
+
+class String
+{
+private:
+    std::string _value;
+
+public:
+    String(const char *value = "") : _value(value) {}
+    const char *c_str() const { return _value.c_str(); }
+    size_t length() const { return _value.length(); }
+    long toInt() const { return atol(_value.c_str()); }
+};
+
+struct EspClass
+{
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+
+inline EspClass ESP;
+
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+
+typedef int esp_err_t;
+#define ESP_OK 0
+inline const char *esp_err_to_name(esp_err_t) { return "ESP_FAIL"; }
+
+// a fixed MAC address, the device id is always "LEDCont123456"
+enum esp_mac_type_t
+{
+    ESP_MAC_WIFI_STA
+};
+
+inline esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    static const uint8_t address[6] = {0x24, 0x0A, 0xC4, 0x12, 0x34, 0x56};
+    memcpy(mac, address, sizeof(address));
+    return ESP_OK;
+}
+
+inline esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t) { return esp_efuse_mac_get_default(mac); }
+
+// FreeRTOS
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int portMUX_TYPE;
+
+#define portNUM_PROCESSORS 2
+#define portMAX_DELAY 0xFFFFFFFF
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define tskIDLE_PRIORITY 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) (ms)
+
+inline int xTaskCreate(void (*)(void *), const char *, uint32_t, void *, int, TaskHandle_t *task)
+{
+    if (task != nullptr)
+        *task = nullptr;
+
+    return pdFALSE;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(int, TickType_t) { return 0; }
+inline TickType_t xTaskGetTickCount() { return millis(); }
+inline int xPortGetCoreID() { return 0; }
+
+#if !defined(__GLIBC__) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char *destination, const char *source, size_t size)
+{
+    size_t length = strlen(source);
+
+    if (size > 0)
+    {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(destination, source, copied);
+        destination[copied] = '\0';
+    }
+
+    return length;
+}
+#endif
+
+#endif // __SHIM_ARDUINO_H__
@@ -0,0 +1,73 @@
+#ifndef __SHIM_PREFERENCES_H__
+#define __SHIM_PREFERENCES_H__
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+/**
+ * @brief Non-volatile storage in memory, the content lives as long as the object
+ */
+class Preferences
+{
+private:
+    std::map<std::string, std::vector<uint8_t>> _values;
+
+    size_t put(const char *key, const void *value, size_t length)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(value);
+        _values[key].assign(bytes, bytes + length);
+        return length;
+    }
+
+    const std::vector<uint8_t> *find(const char *key)
+    {
+        auto entry = _values.find(key);
+        return entry == _values.end() ? nullptr : &entry->second;
+    }
+
+public:
+    bool begin(const char *, bool = false) { return true; }
+    void end() {}
+    void clear() { _values.clear(); }
+    bool isKey(const char *key) { return find(key) != nullptr; }
+
+    size_t getBytesLength(const char *key)
+    {
+        const std::vector<uint8_t> *value = find(key);
+        return value == nullptr ? 0 : value->size();
+    }
+
+    size_t getBytes(const char *key, void *buffer, size_t length)
+    {
+        const std::vector<uint8_t> *value = find(key);
+
+        if (value == nullptr || value->size() > length)
+            return 0;
+
+        memcpy(buffer, value->data(), value->size());
+        return value->size();
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t length) { return put(key, value, length); }
+
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0)
+    {
+        const std::vector<uint8_t> *value = find(key);
+        return value == nullptr || value->size() != 1 ? defaultValue : (*value)[0];
+    }
+
+    size_t putUChar(const char *key, uint8_t value) { return put(key, &value, 1); }
+    bool getBool(const char *key, bool defaultValue = false) { return getUChar(key, defaultValue) != 0; }
+    size_t putBool(const char *key, bool value) { return putUChar(key, value ? 1 : 0); }
+
+    String getString(const char *key, const char *defaultValue = "")
+    {
+        const std::vector<uint8_t> *value = find(key);
+        return value == nullptr ? String(defaultValue) : String(reinterpret_cast<const char *>(value->data()));
+    }
+
+    size_t putString(const char *key, const char *value) { return put(key, value, strlen(value) + 1) - 1; }
+};
+
+#endif // __SHIM_PREFERENCES_H__
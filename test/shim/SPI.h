@@ -0,0 +1,56 @@
+#ifndef __SHIM_SPI_H__
+#define __SHIM_SPI_H__
+
+#include <Arduino.h>
+#include <vector>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+struct SPISettings
+{
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+};
+
+/**
+ * @brief Records what the last transaction clocked out instead of driving the pins
+ */
+class SPIClass
+{
+public:
+    int8_t clockPin = -1;
+    int8_t dataPin = -1;
+    SPISettings settings = SPISettings(0, 0, 0);
+    std::vector<uint8_t> written;
+    uint32_t transactions = 0;
+    bool inTransaction = false;
+
+    void begin(int8_t sck, int8_t, int8_t mosi, int8_t)
+    {
+        clockPin = sck;
+        dataPin = mosi;
+    }
+
+    void beginTransaction(SPISettings transactionSettings)
+    {
+        settings = transactionSettings;
+        written.clear();
+        inTransaction = true;
+    }
+
+    void writeBytes(const uint8_t *data, uint32_t size) { written.insert(written.end(), data, data + size); }
+
+    void endTransaction()
+    {
+        inTransaction = false;
+        transactions++;
+    }
+};
+
+inline SPIClass SPI;
+
+#endif // __SHIM_SPI_H__
@@ -0,0 +1,17 @@
+#ifndef __SHIM_ESP_PM_H__
+#define __SHIM_ESP_PM_H__
+
+// types only, the native environment builds with POWER_MANAGEMENT=0
+typedef void *esp_pm_lock_handle_t;
+
+enum esp_pm_lock_type_t
+{
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP
+};
+
+inline int esp_pm_lock_acquire(esp_pm_lock_handle_t) { return 0; }
+inline int esp_pm_lock_release(esp_pm_lock_handle_t) { return 0; }
+
+#endif // __SHIM_ESP_PM_H__
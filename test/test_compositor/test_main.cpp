@@ -0,0 +1,225 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Compositor.h"
+#include "FrameStats.h"
+#include "LedUtils.h"
+#include "NeoPixelDriver.h"
+
+#define BENCHMARK_MAX_PIXELS 300
+#define BENCHMARK_FRAMES 200
+
+static Compositor _compositor;
+
+/**
+ * @brief Start every test from a single solid layer on a strip of the given length
+ */
+static void resetCompositor(uint16_t pixelCount)
+{
+    _compositor.setOverlayEffect(LightEffect::unknown);
+    _compositor.setBaseEffect(LightEffect::unknown, 0, 0);
+    _compositor.setDimensions(pixelCount, 1);
+}
+
+void setUp(void)
+{
+    resetCompositor(BENCHMARK_MAX_PIXELS);
+}
+
+void tearDown(void)
+{
+}
+
+void test_blend_opaque(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0x00204060, Compositor::blend(0x00FF0000, 0x00204060, BlendMode::blendOpaque, 256));
+    TEST_ASSERT_EQUAL_HEX32(0x00FF0000, Compositor::blend(0x00FF0000, 0x00204060, BlendMode::blendOpaque, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x007F007F, Compositor::blend(0x00FF0000, 0x000000FF, BlendMode::blendOpaque, 128));
+}
+
+void test_blend_keyed_skips_black(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0x00FF0000, Compositor::blend(0x00FF0000, 0x00000000, BlendMode::blendKeyed, 256));
+    TEST_ASSERT_EQUAL_HEX32(0x000000FF, Compositor::blend(0x00FF0000, 0x000000FF, BlendMode::blendKeyed, 256));
+}
+
+void test_blend_add_saturates(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFC030, Compositor::blend(0x80F08010, 0x90204020, BlendMode::blendAdd, 256));
+    TEST_ASSERT_EQUAL_HEX32(0x00F08010, Compositor::blend(0x00F08010, 0x00204020, BlendMode::blendAdd, 0));
+}
+
+void test_crossfade_endpoints(void)
+{
+    _compositor.setBaseEffect(LightEffect::solid, 0, 1000);
+    TEST_ASSERT_TRUE(_compositor.render(1000, 0x00FF0000));
+
+    // the new base starts invisible and covers the outgoing one at the end
+    _compositor.setBaseEffect(LightEffect::rainbow, 400, 1000);
+    _compositor.render(1000, 0x00FF0000);
+    TEST_ASSERT_EQUAL_HEX32(0x00FF0000, _compositor.getFrame()[0]);
+
+    _compositor.render(1400, 0x00FF0000);
+    TEST_ASSERT_EQUAL_HEX32(LedUtils::ColorFromWheel(1), _compositor.getFrame()[0]);
+}
+
+void test_crossfade_midpoint(void)
+{
+    _compositor.setBaseEffect(LightEffect::rainbow, 0, 1000);
+    _compositor.render(1000, 0x00FF0000);
+
+    _compositor.setBaseEffect(LightEffect::solid, 400, 1000);
+    _compositor.render(1200, 0x00FF0000);
+
+    // half way through, the outgoing rainbow (one step further) and the new solid color weigh the same
+    for (uint16_t i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX32(LedUtils::Blend(0x00FF0000, LedUtils::ColorFromWheel(i + 1), 128), _compositor.getFrame()[i]);
+    }
+}
+
+void test_interrupted_crossfade_does_not_jump(void)
+{
+    uint32_t before[4];
+
+    _compositor.setBaseEffect(LightEffect::rainbow, 0, 1000);
+    _compositor.render(1000, 0x00FF0000);
+    _compositor.setBaseEffect(LightEffect::solid, 400, 1000);
+    _compositor.render(1200, 0x00FF0000);
+    memcpy(before, _compositor.getFrame(), sizeof(before));
+
+    // a new effect half way through fades in over the mix that is shown, not over the full rainbow
+    _compositor.setBaseEffect(LightEffect::dot, 400, 1200);
+    _compositor.render(1200, 0x00FF0000);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(before, _compositor.getFrame(), 4);
+
+    _compositor.render(1400, 0x00FF0000);
+    TEST_ASSERT_EQUAL_HEX32(LedUtils::Blend(0x00FF0000, before[1], 128), _compositor.getFrame()[1]);
+
+    // at the end only the dot is left
+    _compositor.render(1600, 0x00FF0000);
+    TEST_ASSERT_EQUAL_HEX32(0, _compositor.getFrame()[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x00FF0000, _compositor.getFrame()[2]);
+}
+
+void test_keyed_overlay_covers_base(void)
+{
+    _compositor.setBaseEffect(LightEffect::rainbow, 0, 0);
+    _compositor.setOverlayEffect(LightEffect::dot);
+    _compositor.render(0, 0x00FFFFFF);
+
+    const uint32_t *frame = _compositor.getFrame();
+    TEST_ASSERT_EQUAL_HEX32(0x00FFFFFF, frame[0]);
+    TEST_ASSERT_EQUAL_HEX32(LedUtils::ColorFromWheel(1), frame[1]);
+}
+
+void test_particle_overlay_adds_light(void)
+{
+    _compositor.setBaseEffect(LightEffect::solid, 0, 0);
+    _compositor.setOverlayEffect(LightEffect::confetti);
+
+    bool brighter = false;
+
+    for (unsigned long now = 0; now < 1000; now += FRAME_INTERVAL_MILLIS)
+    {
+        _compositor.render(now, 0x00200000);
+
+        for (uint16_t i = 0; i < _compositor.getPixelCount(); i++)
+        {
+            uint32_t pixel = _compositor.getFrame()[i];
+
+            // nothing gets darker than the base, particles only add
+            TEST_ASSERT_TRUE(((pixel >> 16) & 0xFF) >= 0x20);
+            brighter |= pixel != 0x00200000;
+        }
+    }
+
+    TEST_ASSERT_TRUE(brighter);
+}
+
+/**
+ * @brief Render the heaviest layer stack: a noise crossfade with a particle overlay
+ *
+ * @param pixelCount The length of the strip
+ */
+static void benchmarkFrame(uint16_t pixelCount)
+{
+    resetCompositor(pixelCount);
+
+    // the crossfade lasts longer than the benchmark, all three layers stay active
+    _compositor.setBaseEffect(LightEffect::lava, 0, 0);
+    _compositor.setBaseEffect(LightEffect::aurora, 60000, 0);
+    _compositor.setOverlayEffect(LightEffect::confetti);
+
+    uint32_t total = 0;
+    uint32_t slowest = 0;
+
+    for (uint16_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+    {
+        unsigned long start = micros();
+        _compositor.render(frame * FRAME_INTERVAL_MILLIS, 0x00FF8020);
+        uint32_t elapsed = micros() - start;
+
+        total += elapsed;
+        slowest = max(slowest, elapsed);
+    }
+
+    uint32_t average = total / BENCHMARK_FRAMES;
+
+    // an SK6812 strip spends this long on the wire, the render has to fit into the rest of the frame
+    uint32_t wireMicros = (pixelCount * 4 * 8 * 125) / 100 + NEOPIXEL_LATCH_MICROS;
+    uint32_t budget = FRAME_INTERVAL_MILLIS * 1000 - wireMicros;
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u px, 3 layers: render avg %u us, max %u us, budget %u us (wire %u us)",
+             (unsigned)pixelCount, (unsigned)average, (unsigned)slowest, (unsigned)budget, (unsigned)wireMicros);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(budget, average);
+}
+
+void test_frame_budget_150_pixels(void)
+{
+    benchmarkFrame(150);
+}
+
+void test_frame_budget_300_pixels(void)
+{
+    benchmarkFrame(300);
+}
+
+int runUnityTests(void)
+{
+    if (!_compositor.setup(BENCHMARK_MAX_PIXELS))
+        return 1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_blend_opaque);
+    RUN_TEST(test_blend_keyed_skips_black);
+    RUN_TEST(test_blend_add_saturates);
+    RUN_TEST(test_crossfade_endpoints);
+    RUN_TEST(test_crossfade_midpoint);
+    RUN_TEST(test_interrupted_crossfade_does_not_jump);
+    RUN_TEST(test_keyed_overlay_covers_base);
+    RUN_TEST(test_particle_overlay_adds_light);
+    RUN_TEST(test_frame_budget_150_pixels);
+    RUN_TEST(test_frame_budget_300_pixels);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    // the board needs a moment before the test runner listens on the serial port
+    delay(2000);
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,297 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Preferences.h"
+#include "Adafruit_NeoPixel.h"
+#include "DeviceUtils.h"
+#include "LedController.h"
+#include "CommandRouter.h"
+#include "PresetStore.h"
+#include "FrameStats.h"
+
+#define FAKE_BROKER_QUEUE 4
+
+static Preferences _preferences;
+static DeviceUtils _deviceUtils(&_preferences);
+static LedController _ledController(&_preferences);
+static PresetStore _presetStore(&_preferences);
+static CommandRouter _commandRouter(&_ledController, &_presetStore, &_deviceUtils);
+
+/**
+ * @brief Stands in for the broker and AsyncMqttClient: published messages are queued and
+ * handed to the command router in order, as onMqttMessage() of main.cpp does
+ */
+class FakeBroker
+{
+private:
+    struct Message
+    {
+        char topic[TOPIC_LENGTH];
+        char payload[MQTT_PAYLOAD_BUFFER_SIZE];
+    };
+
+    Message _queue[FAKE_BROKER_QUEUE];
+    uint8_t _count = 0;
+
+    void onMessage(const char *topic, const char *payload, size_t len)
+    {
+        CommandTrace trace;
+        trace.receivedMicros = micros();
+
+        bool applied;
+        TEST_ASSERT_NOT_EQUAL(CommandTopic::topicUnknown, _commandRouter.route(topic, payload, len, &trace, &applied));
+    }
+
+public:
+    void publish(const char *topic, const char *payload)
+    {
+        TEST_ASSERT_LESS_THAN(FAKE_BROKER_QUEUE, _count);
+
+        strlcpy(_queue[_count].topic, topic, TOPIC_LENGTH);
+        strlcpy(_queue[_count].payload, payload, MQTT_PAYLOAD_BUFFER_SIZE);
+        _count++;
+    }
+
+    /**
+     * @brief Deliver every queued message, as the network side would between two frames
+     */
+    void deliver()
+    {
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            onMessage(_queue[i].topic, _queue[i].payload, strlen(_queue[i].payload));
+        }
+
+        _count = 0;
+    }
+};
+
+static FakeBroker _broker;
+
+/**
+ * @brief Let the render task run the next frame
+ */
+static void renderFrame()
+{
+    ShimClock::advanceMillis(FRAME_INTERVAL_MILLIS);
+    _ledController.loop();
+}
+
+static const std::vector<uint8_t> &strip()
+{
+    return Adafruit_NeoPixel::Wire[EXTERNAL_LED_PIN];
+}
+
+static uint32_t stripShows()
+{
+    return Adafruit_NeoPixel::ShowCount[EXTERNAL_LED_PIN];
+}
+
+/**
+ * @brief Check every pixel of the SK6812 strip, the bytes are in GRBW order
+ */
+static void assertStrip(uint8_t red, uint8_t green, uint8_t blue, uint8_t white)
+{
+    const uint8_t expected[4] = {green, red, blue, white};
+
+    TEST_ASSERT_EQUAL(EXTERNAL_LED_LENGTH * 4, strip().size());
+
+    for (size_t i = 0; i < strip().size(); i += 4)
+    {
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, &strip()[i], 4);
+    }
+}
+
+void setUp(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(),
+                    "{\"state\":\"ON\",\"brightness\":255,\"color\":{\"r\":0,\"g\":0,\"b\":0,\"w\":0},\"effect\":\"solid\",\"overlay\":\"none\"}");
+    _broker.deliver();
+    renderFrame();
+}
+
+void tearDown(void)
+{
+}
+
+void test_command_reaches_the_strip(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"color\":{\"r\":255,\"g\":0,\"b\":0,\"w\":0}}");
+    _broker.deliver();
+
+    // nothing is shown before the render task picks the update up
+    TEST_ASSERT_TRUE(_ledController.hasPendingState());
+    TEST_ASSERT_LESS_OR_EQUAL(FRAME_INTERVAL_MILLIS, _ledController.getFrameDelay());
+
+    renderFrame();
+
+    TEST_ASSERT_FALSE(_ledController.hasPendingState());
+    assertStrip(255, 0, 0, 0);
+}
+
+void test_brightness_scales_the_wire_bytes(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"brightness\":128,\"color\":{\"r\":255,\"g\":0,\"b\":0,\"w\":200}}");
+    _broker.deliver();
+    renderFrame();
+
+    // Adafruit_NeoPixel scales with (value * (brightness + 1)) >> 8
+    assertStrip(128, 0, 0, 100);
+}
+
+void test_commands_within_one_frame_merge(void)
+{
+    uint32_t shows = stripShows();
+    uint32_t traced = _ledController.getLatencyTracer()->getCount();
+
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"color\":{\"r\":0,\"g\":0,\"b\":255,\"w\":0}}");
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"brightness\":64}");
+    _broker.deliver();
+    renderFrame();
+
+    // one frame carries both commands, the latest command is the one measured
+    TEST_ASSERT_EQUAL(shows + 1, stripShows());
+    TEST_ASSERT_EQUAL(traced + 1, _ledController.getLatencyTracer()->getCount());
+    assertStrip(0, 0, 64, 0);
+
+    LightState state = _ledController.getState();
+    TEST_ASSERT_EQUAL(255, state.blue);
+    TEST_ASSERT_EQUAL(64, state.brightness);
+}
+
+void test_static_output_is_not_sent_again(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"color\":{\"r\":0,\"g\":255,\"b\":0,\"w\":0}}");
+    _broker.deliver();
+    renderFrame();
+
+    uint32_t shows = stripShows();
+
+    renderFrame();
+    renderFrame();
+
+    TEST_ASSERT_EQUAL(shows, stripShows());
+    TEST_ASSERT_EQUAL(UINT32_MAX, _ledController.getFrameDelay());
+}
+
+void test_preset_recall_reaches_the_strip(void)
+{
+    LightState state = _ledController.getState();
+    state.lightOn = true;
+    state.red = 0;
+    state.green = 255;
+    state.blue = 0;
+    state.white = 10;
+    state.brightness = 255;
+    state.lightEffect = LightEffect::solid;
+    state.overlayEffect = LightEffect::unknown;
+    TEST_ASSERT_TRUE(_presetStore.save(3, "evening", &state));
+
+    _broker.publish(_deviceUtils.GetPresetTopic(), "3");
+    _broker.deliver();
+    renderFrame();
+
+    assertStrip(0, 255, 0, 10);
+    TEST_ASSERT_EQUAL(255, _ledController.getState().green);
+}
+
+void test_off_clears_the_strip(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"color\":{\"r\":255,\"g\":255,\"b\":255,\"w\":255}}");
+    _broker.deliver();
+    renderFrame();
+
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"state\":\"OFF\"}");
+    _broker.deliver();
+    renderFrame();
+
+    assertStrip(0, 0, 0, 0);
+    TEST_ASSERT_FALSE(_ledController.getState().lightOn);
+}
+
+void test_invalid_command_is_dropped(void)
+{
+    uint32_t shows = stripShows();
+
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"state\":");
+    _broker.publish(_deviceUtils.GetPresetTopic(), "7");
+    _broker.deliver();
+
+    TEST_ASSERT_FALSE(_ledController.hasPendingState());
+
+    renderFrame();
+    TEST_ASSERT_EQUAL(shows, stripShows());
+}
+
+void test_invalid_preset_ids_are_dropped(void)
+{
+    LightState state = _ledController.getState();
+    state.red = 255;
+    TEST_ASSERT_TRUE(_presetStore.save(0, "zero", &state));
+
+    // atoi() would read all of these as preset 0
+    const char *payloads[] = {"abc", "300", "0x1", "-0", "0000"};
+
+    for (const char *payload : payloads)
+    {
+        _broker.publish(_deviceUtils.GetPresetTopic(), payload);
+        _broker.deliver();
+
+        TEST_ASSERT_FALSE(_ledController.hasPendingState());
+    }
+
+    uint8_t id;
+    TEST_ASSERT_TRUE(CommandRouter::ParsePresetId("255", 3, &id));
+    TEST_ASSERT_EQUAL(255, id);
+    TEST_ASSERT_TRUE(CommandRouter::ParsePresetId("\x03", 1, &id));
+    TEST_ASSERT_EQUAL(3, id);
+    TEST_ASSERT_FALSE(CommandRouter::ParsePresetId("", 0, &id));
+
+    TEST_ASSERT_TRUE(_presetStore.remove(0));
+}
+
+void test_latency_report(void)
+{
+    _broker.publish(_deviceUtils.GetCommandTopic(), "{\"color\":{\"r\":1,\"g\":2,\"b\":3,\"w\":4}}");
+    _broker.deliver();
+    renderFrame();
+
+    LatencyTracer *tracer = _ledController.getLatencyTracer();
+    TEST_ASSERT_GREATER_THAN(0, tracer->getCount());
+
+    char json[512];
+    tracer->toJson(json, sizeof(json));
+    TEST_MESSAGE(json);
+
+    // the command waited for the next frame, at most one frame interval plus the frame itself
+    const char *total = strstr(json, "\"total\":");
+    TEST_ASSERT_NOT_NULL(total);
+
+    unsigned p50, p90, p99, max;
+    TEST_ASSERT_EQUAL(4, sscanf(total, "\"total\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}", &p50, &p90, &p99, &max));
+    TEST_ASSERT_LESS_OR_EQUAL(FRAME_INTERVAL_MILLIS * 1000 * 2, max);
+}
+
+int runUnityTests(void)
+{
+    _preferences.putString(PREF_DEVICE_NAME_KEY, DeviceUtils::GenerateDeviceId().c_str());
+    _deviceUtils.Init();
+    _presetStore.setup();
+    _ledController.setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_command_reaches_the_strip);
+    RUN_TEST(test_brightness_scales_the_wire_bytes);
+    RUN_TEST(test_commands_within_one_frame_merge);
+    RUN_TEST(test_static_output_is_not_sent_again);
+    RUN_TEST(test_preset_recall_reaches_the_strip);
+    RUN_TEST(test_off_clears_the_strip);
+    RUN_TEST(test_invalid_command_is_dropped);
+    RUN_TEST(test_invalid_preset_ids_are_dropped);
+    RUN_TEST(test_latency_report);
+    return UNITY_END();
+}
+
+int main(void)
+{
+    return runUnityTests();
+}
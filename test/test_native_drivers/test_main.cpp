@@ -0,0 +1,215 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "SPI.h"
+#include "Adafruit_NeoPixel.h"
+#include "Apa102Driver.h"
+#include "NeoPixelDriver.h"
+#include "FrameStats.h"
+
+#define TEST_PIXELS 150
+#define TEST_DATA_PIN 1
+#define TEST_CLOCK_PIN 2
+#define TEST_WS2812_PIN 10
+#define TEST_SK6812_PIN 11
+
+static Apa102Driver _apa102(TEST_DATA_PIN, TEST_CLOCK_PIN);
+static Apa102Driver _sk9822(TEST_DATA_PIN, TEST_CLOCK_PIN);
+static NeoPixelDriver _ws2812(TEST_WS2812_PIN);
+static NeoPixelDriver _sk6812(TEST_SK6812_PIN);
+
+void setUp(void)
+{
+    LedDriver *drivers[] = {&_apa102, &_sk9822, &_ws2812, &_sk6812};
+
+    for (LedDriver *driver : drivers)
+    {
+        driver->setBrightness(255);
+        driver->clear();
+    }
+}
+
+void tearDown(void)
+{
+}
+
+void test_apa102_frame_layout(void)
+{
+    _apa102.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30));
+    _apa102.setPixel(TEST_PIXELS - 1, Adafruit_NeoPixel::Color(0x01, 0x02, 0x03));
+    _apa102.show();
+
+    // start frame, [0xE0 | brightness, B, G, R] per LED, end frame of ones for the extra clock edges
+    const std::vector<uint8_t> &wire = SPI.written;
+    const uint8_t first[4] = {0xFF, 0x30, 0x20, 0x10};
+    const uint8_t last[4] = {0xFF, 0x03, 0x02, 0x01};
+    size_t endFrame = (TEST_PIXELS + 15) / 16;
+
+    TEST_ASSERT_EQUAL(4 + TEST_PIXELS * 4 + endFrame, wire.size());
+    TEST_ASSERT_EQUAL(wire.size(), _apa102.frameBytes());
+    TEST_ASSERT_EACH_EQUAL_HEX8(0x00, &wire[0], 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first, &wire[4], 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(last, &wire[4 + (TEST_PIXELS - 1) * 4], 4);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xFF, &wire[4 + TEST_PIXELS * 4], endFrame);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(_apa102.getBuffer(), wire.data(), wire.size());
+}
+
+void test_apa102_spi_settings(void)
+{
+    _apa102.show();
+
+    TEST_ASSERT_EQUAL(TEST_CLOCK_PIN, SPI.clockPin);
+    TEST_ASSERT_EQUAL(TEST_DATA_PIN, SPI.dataPin);
+    TEST_ASSERT_EQUAL(SPI_LED_FREQUENCY, SPI.settings.clock);
+    TEST_ASSERT_EQUAL(MSBFIRST, SPI.settings.bitOrder);
+    TEST_ASSERT_EQUAL(SPI_MODE0, SPI.settings.dataMode);
+    TEST_ASSERT_FALSE(SPI.inTransaction);
+}
+
+void test_apa102_mixes_white_into_rgb(void)
+{
+    _apa102.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30, 0x40));
+    _apa102.setPixel(1, Adafruit_NeoPixel::Color(0xF0, 0x20, 0x30, 0x40));
+    _apa102.show();
+
+    const uint8_t mixed[4] = {0xFF, 0x70, 0x60, 0x50};
+    const uint8_t saturated[4] = {0xFF, 0x70, 0x60, 0xFF};
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(mixed, &SPI.written[4], 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(saturated, &SPI.written[8], 4);
+}
+
+void test_apa102_brightness_uses_the_global_bits(void)
+{
+    const uint8_t brightness[] = {0, 1, 8, 64, 128, 248, 255};
+    const uint8_t header[] = {0xE0, 0xE1, 0xE1, 0xE8, 0xF0, 0xFF, 0xFF};
+
+    for (size_t i = 0; i < sizeof(brightness); i++)
+    {
+        _apa102.setBrightness(brightness[i]);
+        _apa102.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30));
+        _apa102.show();
+
+        // the colors keep their full resolution, only the 5 bit brightness changes
+        const uint8_t expected[4] = {header[i], 0x30, 0x20, 0x10};
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, &SPI.written[4], 4);
+        TEST_ASSERT_EQUAL_HEX8(header[i], SPI.written[4 + (TEST_PIXELS - 1) * 4]);
+    }
+}
+
+void test_sk9822_end_frame(void)
+{
+    _sk9822.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30));
+    _sk9822.show();
+
+    // a reset frame of 32 zero bits, then zeros for the extra clock edges
+    size_t endFrame = 4 + (TEST_PIXELS + 15) / 16;
+    const uint8_t first[4] = {0xFF, 0x30, 0x20, 0x10};
+
+    TEST_ASSERT_EQUAL(4 + TEST_PIXELS * 4 + endFrame, SPI.written.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first, &SPI.written[4], 4);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0x00, &SPI.written[4 + TEST_PIXELS * 4], endFrame);
+}
+
+void test_ws2812_wire_bytes(void)
+{
+    _ws2812.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30, 0x40));
+    _ws2812.show();
+
+    // GRB, the white channel is added to the colors
+    const std::vector<uint8_t> &wire = Adafruit_NeoPixel::Wire[TEST_WS2812_PIN];
+    const uint8_t first[3] = {0x60, 0x50, 0x70};
+
+    TEST_ASSERT_EQUAL(TEST_PIXELS * 3, wire.size());
+    TEST_ASSERT_EQUAL(wire.size(), _ws2812.frameBytes());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first, &wire[0], 3);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0x00, &wire[3], wire.size() - 3);
+}
+
+void test_ws2812_shows_white_only_pixels(void)
+{
+    _ws2812.setPixel(0, Adafruit_NeoPixel::Color(0, 0, 0, 0xC0));
+    _ws2812.setPixel(1, Adafruit_NeoPixel::Color(0xF0, 0x00, 0x80, 0x40));
+    _ws2812.show();
+
+    // a white-only pixel would be dark without the mix, the channels saturate instead of wrapping
+    const std::vector<uint8_t> &wire = Adafruit_NeoPixel::Wire[TEST_WS2812_PIN];
+    const uint8_t white[3] = {0xC0, 0xC0, 0xC0};
+    const uint8_t saturated[3] = {0x40, 0xFF, 0xC0};
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(white, &wire[0], 3);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(saturated, &wire[3], 3);
+}
+
+void test_sk6812_wire_bytes(void)
+{
+    _sk6812.setBrightness(128);
+    _sk6812.setPixel(0, Adafruit_NeoPixel::Color(0x10, 0x20, 0x30, 0xFF));
+    _sk6812.show();
+
+    // GRBW, scaled by the brightness
+    const std::vector<uint8_t> &wire = Adafruit_NeoPixel::Wire[TEST_SK6812_PIN];
+    const uint8_t first[4] = {0x10, 0x08, 0x18, 0x80};
+
+    TEST_ASSERT_EQUAL(TEST_PIXELS * 4, wire.size());
+    TEST_ASSERT_EQUAL(wire.size(), _sk6812.frameBytes());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first, &wire[0], 4);
+    TEST_ASSERT_EQUAL(128, _sk6812.getBrightness());
+}
+
+void test_rejects_foreign_chipsets(void)
+{
+    Apa102Driver apa102(TEST_DATA_PIN, TEST_CLOCK_PIN);
+    NeoPixelDriver neoPixel(TEST_WS2812_PIN);
+
+    TEST_ASSERT_FALSE(apa102.begin(LedChipset::ws2812, TEST_PIXELS));
+    TEST_ASSERT_FALSE(neoPixel.begin(LedChipset::apa102, TEST_PIXELS));
+}
+
+/**
+ * @brief The time one frame needs on the wire and the frame rate this allows, per chipset
+ */
+void test_wire_throughput(void)
+{
+    LedDriver *drivers[] = {&_ws2812, &_sk6812, &_apa102, &_sk9822};
+    const uint32_t expectedMicros[] = {4800, 6300, 614, 618};
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        LedDriver *driver = drivers[i];
+        uint32_t wireMicros = driver->wireMicros();
+
+        char message[128];
+        snprintf(message, sizeof(message), "%-6s %u px: %4u B, %5u us on the wire, %u fps max",
+                 LedDriver::ChipsetName(driver->chipset()), (unsigned)driver->numPixels(), (unsigned)driver->frameBytes(),
+                 (unsigned)wireMicros, (unsigned)(1000000 / wireMicros));
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_EQUAL(expectedMicros[i], wireMicros);
+        TEST_ASSERT_LESS_THAN(FRAME_INTERVAL_MILLIS * 1000, wireMicros);
+    }
+}
+
+int runUnityTests(void)
+{
+    if (!_apa102.begin(LedChipset::apa102, TEST_PIXELS) || !_sk9822.begin(LedChipset::sk9822, TEST_PIXELS) ||
+        !_ws2812.begin(LedChipset::ws2812, TEST_PIXELS) || !_sk6812.begin(LedChipset::sk6812, TEST_PIXELS))
+        return 1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_apa102_frame_layout);
+    RUN_TEST(test_apa102_spi_settings);
+    RUN_TEST(test_apa102_mixes_white_into_rgb);
+    RUN_TEST(test_apa102_brightness_uses_the_global_bits);
+    RUN_TEST(test_sk9822_end_frame);
+    RUN_TEST(test_ws2812_wire_bytes);
+    RUN_TEST(test_ws2812_shows_white_only_pixels);
+    RUN_TEST(test_sk6812_wire_bytes);
+    RUN_TEST(test_rejects_foreign_chipsets);
+    RUN_TEST(test_wire_throughput);
+    return UNITY_END();
+}
+
+int main(void)
+{
+    return runUnityTests();
+}
@@ -0,0 +1,259 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Noise.h"
+#include "LedUtils.h"
+#include "Compositor.h"
+#include "FrameStats.h"
+
+// the golden values below were taken from the native build, every target has to reproduce them bit for bit.
+// 32 bit FNV-1a, Unity on the ESP32 targets is built without 64 bit support
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME 0x01000193
+
+#define GOLDEN_FRAMES 64
+#define STRIP_PIXELS 150
+#define MATRIX_WIDTH 16
+#define MATRIX_HEIGHT 8
+#define BENCHMARK_SAMPLES 20000
+
+static Compositor _compositor;
+
+static uint32_t hashValue(uint32_t hash, uint32_t value)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_sample_spot_values(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(128, Noise::Sample1D(0));
+    TEST_ASSERT_EQUAL_UINT8(44, Noise::Sample1D(0x8000));
+    TEST_ASSERT_EQUAL_UINT8(96, Noise::Sample1D(0x123456));
+    TEST_ASSERT_EQUAL_UINT8(28, Noise::Sample2D(0x8000, 0x8000));
+    TEST_ASSERT_EQUAL_UINT8(153, Noise::Sample3D(0x18000, 0x28000, 0x38000));
+    TEST_ASSERT_EQUAL_UINT8(67, Noise::Fractal2D(0x12345, 0x6789A, 3));
+}
+
+void test_sample_golden_hashes(void)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (uint32_t i = 0; i < 4096; i++)
+        hash = hashValue(hash, Noise::Sample1D(i * 0x1357B));
+    TEST_ASSERT_EQUAL_HEX32(0x1CB64CEA, hash);
+
+    hash = FNV_OFFSET_BASIS;
+    for (uint32_t y = 0; y < 64; y++)
+        for (uint32_t x = 0; x < 64; x++)
+            hash = hashValue(hash, Noise::Sample2D(x * 0x2345, y * 0x3B71 + 0x800000));
+    TEST_ASSERT_EQUAL_HEX32(0x9EB46550, hash);
+
+    hash = FNV_OFFSET_BASIS;
+    for (uint32_t z = 0; z < 16; z++)
+        for (uint32_t y = 0; y < 16; y++)
+            for (uint32_t x = 0; x < 16; x++)
+                hash = hashValue(hash, Noise::Sample3D(x * 0x4567, y * 0x2F11, z * 0x9ABC));
+    TEST_ASSERT_EQUAL_HEX32(0x09CA2620, hash);
+}
+
+void test_fractal_golden_hashes(void)
+{
+    const uint32_t expected2D[] = {0x797686AB, 0x797CABC5, 0xB7985C44, 0x3858A8A3};
+    const uint32_t expected3D[] = {0x0A13B86D, 0xF89760AA, 0x35BE6DEE, 0xCC2ED323};
+
+    for (uint8_t octaves = 1; octaves <= 4; octaves++)
+    {
+        uint32_t hash = FNV_OFFSET_BASIS;
+        for (uint32_t y = 0; y < 32; y++)
+            for (uint32_t x = 0; x < 32; x++)
+                hash = hashValue(hash, Noise::Fractal2D(x * 0x2000, y * 0x1800, octaves));
+        TEST_ASSERT_EQUAL_HEX32(expected2D[octaves - 1], hash);
+
+        hash = FNV_OFFSET_BASIS;
+        for (uint32_t z = 0; z < 8; z++)
+            for (uint32_t y = 0; y < 8; y++)
+                for (uint32_t x = 0; x < 8; x++)
+                    hash = hashValue(hash, Noise::Fractal3D(x * 0x3000, y * 0x3000, z * 0x1000, octaves));
+        TEST_ASSERT_EQUAL_HEX32(expected3D[octaves - 1], hash);
+    }
+}
+
+void test_fractal_clamps_the_octaves(void)
+{
+    for (uint32_t x = 0; x < 16 * NOISE_CELL; x += 0x7777)
+    {
+        TEST_ASSERT_EQUAL_UINT8(Noise::Fractal2D(x, 0x5000, 1), Noise::Fractal2D(x, 0x5000, 0));
+        TEST_ASSERT_EQUAL_UINT8(Noise::Fractal2D(x, 0x5000, 4), Noise::Fractal2D(x, 0x5000, 5));
+        TEST_ASSERT_EQUAL_UINT8(Noise::Fractal3D(x, 0x5000, 0x9000, 1), Noise::Fractal3D(x, 0x5000, 0x9000, 0));
+        TEST_ASSERT_EQUAL_UINT8(Noise::Fractal3D(x, 0x5000, 0x9000, 4), Noise::Fractal3D(x, 0x5000, 0x9000, 255));
+    }
+}
+
+void test_noise_wraps_without_a_seam(void)
+{
+    // the lattice repeats every 256 cells
+    for (uint32_t x = 0; x < 64 * NOISE_CELL; x += 0x3333)
+    {
+        TEST_ASSERT_EQUAL_UINT8(Noise::Sample1D(x), Noise::Sample1D(x + 256 * NOISE_CELL));
+        TEST_ASSERT_EQUAL_UINT8(Noise::Sample2D(x, 0x4000), Noise::Sample2D(x + 256 * NOISE_CELL, 0x4000));
+    }
+}
+
+void test_color_from_palette(void)
+{
+    static const uint32_t gray[16] = {
+        0x000000, 0x111111, 0x222222, 0x333333, 0x444444, 0x555555, 0x666666, 0x777777,
+        0x888888, 0x999999, 0xAAAAAA, 0xBBBBBB, 0xCCCCCC, 0xDDDDDD, 0xEEEEEE, 0xFFFFFF};
+
+    // 16 steps between two entries, the last entry is held
+    TEST_ASSERT_EQUAL_HEX32(0x000000, LedUtils::ColorFromPalette(gray, 0x00));
+    TEST_ASSERT_EQUAL_HEX32(0x080808, LedUtils::ColorFromPalette(gray, 0x08));
+    TEST_ASSERT_EQUAL_HEX32(0x0F0F0F, LedUtils::ColorFromPalette(gray, 0x0F));
+    TEST_ASSERT_EQUAL_HEX32(0x111111, LedUtils::ColorFromPalette(gray, 0x10));
+    TEST_ASSERT_EQUAL_HEX32(0x909090, LedUtils::ColorFromPalette(gray, 0x88));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFF, LedUtils::ColorFromPalette(gray, 0xF0));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFF, LedUtils::ColorFromPalette(gray, 0xFF));
+}
+
+/**
+ * @brief Hash the first frames of a noise effect, on the strip and on a matrix
+ */
+static void assertFrames(LightEffect effect, uint32_t expectedStrip, uint32_t expectedMatrix)
+{
+    const uint16_t widths[] = {STRIP_PIXELS, MATRIX_WIDTH};
+    const uint16_t heights[] = {1, MATRIX_HEIGHT};
+    const uint32_t expected[] = {expectedStrip, expectedMatrix};
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        _compositor.setBaseEffect(LightEffect::unknown, 0, 0);
+        _compositor.setDimensions(widths[i], heights[i]);
+        _compositor.setBaseEffect(effect, 0, 0);
+
+        uint32_t hash = FNV_OFFSET_BASIS;
+
+        for (uint16_t frame = 0; frame < GOLDEN_FRAMES; frame++)
+        {
+            _compositor.render(frame * FRAME_INTERVAL_MILLIS, 0x00FFFFFF);
+
+            for (uint16_t p = 0; p < _compositor.getPixelCount(); p++)
+                hash = hashValue(hash, _compositor.getFrame()[p]);
+        }
+
+        TEST_ASSERT_EQUAL_HEX32(expected[i], hash);
+    }
+}
+
+void test_lava_frames(void)
+{
+    assertFrames(LightEffect::lava, 0x0F04B5E7, 0x6594D29E);
+}
+
+void test_ocean_frames(void)
+{
+    assertFrames(LightEffect::ocean, 0x3F133C91, 0x16D1342A);
+}
+
+void test_aurora_frames(void)
+{
+    assertFrames(LightEffect::aurora, 0x38B3C6F5, 0x8C4C0426);
+}
+
+void test_plasma_frames(void)
+{
+    assertFrames(LightEffect::plasma, 0x0EA4CA21, 0x7994BA2D);
+}
+
+/**
+ * @brief Time the noise functions the effects use, per sample and for one 150 px lava layer
+ */
+void test_noise_benchmark(void)
+{
+    const char *names[] = {"Sample2D", "Fractal2D x3", "Fractal3D x2"};
+    uint32_t nanos[3];
+    uint32_t sink = 0;
+
+    for (uint8_t kind = 0; kind < 3; kind++)
+    {
+        unsigned long start = micros();
+
+        for (uint32_t i = 0; i < BENCHMARK_SAMPLES; i++)
+        {
+            uint32_t x = i * 8192;
+
+            if (kind == 0)
+                sink += Noise::Sample2D(x, i);
+            else if (kind == 1)
+                sink += Noise::Fractal2D(x, i << 9, 3);
+            else
+                sink += Noise::Fractal3D(x, x >> 3, i << 9, 2);
+        }
+
+        nanos[kind] = (uint64_t)(micros() - start) * 1000 / BENCHMARK_SAMPLES;
+
+        char message[96];
+        snprintf(message, sizeof(message), "%-12s %5u ns per sample", names[kind], (unsigned)nanos[kind]);
+        TEST_MESSAGE(message);
+    }
+
+    // keeps the loops from being optimized away
+    TEST_ASSERT_NOT_EQUAL(0, sink);
+
+    // the lava layer of a 150 px strip samples 3 octaves per pixel, it must leave most of the frame for the rest
+    uint32_t layerMicros = nanos[1] * STRIP_PIXELS / 1000;
+    char message[96];
+    snprintf(message, sizeof(message), "lava layer, %u px: %u us", (unsigned)STRIP_PIXELS, (unsigned)layerMicros);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(FRAME_INTERVAL_MILLIS * 1000 / 4, layerMicros);
+}
+
+int runUnityTests(void)
+{
+    if (!_compositor.setup(STRIP_PIXELS))
+        return 1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sample_spot_values);
+    RUN_TEST(test_sample_golden_hashes);
+    RUN_TEST(test_fractal_golden_hashes);
+    RUN_TEST(test_fractal_clamps_the_octaves);
+    RUN_TEST(test_noise_wraps_without_a_seam);
+    RUN_TEST(test_color_from_palette);
+    RUN_TEST(test_lava_frames);
+    RUN_TEST(test_ocean_frames);
+    RUN_TEST(test_aurora_frames);
+    RUN_TEST(test_plasma_frames);
+    RUN_TEST(test_noise_benchmark);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    // the board needs a moment before the test runner listens on the serial port
+    delay(2000);
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
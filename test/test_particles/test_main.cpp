@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "ParticleSystem.h"
+#include "Compositor.h"
+#include "FrameStats.h"
+
+#define STRIP_PIXELS 150
+#define SMALL_SHARE 16
+#define BENCHMARK_FRAMES 300
+
+static ParticleSystem _pool;        // sized like the pool of the compositor
+static ParticleSystem _small;       // 2 owners with a small share, to reach the limits quickly
+static uint32_t _pixels[STRIP_PIXELS];
+
+static void clearOwners(ParticleSystem *particles, uint8_t owners)
+{
+    for (uint8_t owner = 0; owner < owners; owner++)
+        particles->clear(owner);
+}
+
+static uint16_t sumOwners(ParticleSystem *particles, uint8_t owners)
+{
+    uint16_t sum = 0;
+
+    for (uint8_t owner = 0; owner < owners; owner++)
+        sum += particles->getCount(owner);
+
+    return sum;
+}
+
+void setUp(void)
+{
+    clearOwners(&_pool, COMPOSITOR_LAYERS);
+    clearOwners(&_small, 2);
+    memset(_pixels, 0, sizeof(_pixels));
+}
+
+void tearDown(void)
+{
+}
+
+void test_share_caps_every_owner(void)
+{
+    for (uint16_t frame = 0; frame < 64; frame++)
+        _small.emit(0, LightEffect::confetti, 0, STRIP_PIXELS, frame);
+
+    TEST_ASSERT_EQUAL(SMALL_SHARE, _small.getCount(0));
+
+    // a full owner does not starve the other one
+    for (uint16_t frame = 0; frame < 4; frame++)
+        _small.emit(1, LightEffect::confetti, 0, STRIP_PIXELS, frame);
+
+    TEST_ASSERT_GREATER_THAN(0, _small.getCount(1));
+    TEST_ASSERT_EQUAL(_small.getCount(), sumOwners(&_small, 2));
+}
+
+void test_update_retires_expired_particles(void)
+{
+    for (uint16_t frame = 0; frame < 4; frame++)
+        _small.emit(0, LightEffect::sparkle, 0, STRIP_PIXELS, frame);
+
+    TEST_ASSERT_GREATER_THAN(0, _small.getCount(0));
+
+    // sparkles live at most 13 frames
+    for (uint16_t frame = 0; frame < 14; frame++)
+        _small.update(0, STRIP_PIXELS);
+
+    TEST_ASSERT_EQUAL(0, _small.getCount(0));
+    TEST_ASSERT_EQUAL(0, _small.getCount());
+}
+
+void test_clear_and_transfer_keep_the_counts(void)
+{
+    for (uint16_t frame = 0; frame < 3; frame++)
+    {
+        _small.emit(0, LightEffect::confetti, 0, STRIP_PIXELS, frame);
+        _small.emit(1, LightEffect::fire, 0, STRIP_PIXELS, frame);
+    }
+
+    uint16_t first = _small.getCount(0);
+    uint16_t second = _small.getCount(1);
+
+    _small.transfer(0, 1);
+    TEST_ASSERT_EQUAL(0, _small.getCount(0));
+    TEST_ASSERT_EQUAL(first + second, _small.getCount(1));
+
+    // the transferred particles render and retire with their new owner
+    _small.render(0, _pixels, STRIP_PIXELS);
+    for (uint16_t i = 0; i < STRIP_PIXELS; i++)
+        TEST_ASSERT_EQUAL_HEX32(0, _pixels[i]);
+
+    _small.clear(1);
+    TEST_ASSERT_EQUAL(0, _small.getCount());
+}
+
+void test_render_only_adds_the_owner(void)
+{
+    _small.emit(1, LightEffect::sparkle, 0, STRIP_PIXELS, 0);
+    _small.render(0, _pixels, STRIP_PIXELS);
+
+    for (uint16_t i = 0; i < STRIP_PIXELS; i++)
+        TEST_ASSERT_EQUAL_HEX32(0, _pixels[i]);
+
+    _small.render(1, _pixels, STRIP_PIXELS);
+
+    uint16_t lit = 0;
+    for (uint16_t i = 0; i < STRIP_PIXELS; i++)
+        lit += _pixels[i] != 0;
+
+    TEST_ASSERT_GREATER_THAN(0, lit);
+}
+
+/**
+ * @brief Run confetti on every layer, hundreds of particles are alive at the same time
+ */
+void test_particle_benchmark(void)
+{
+    uint16_t peak = 0;
+    uint32_t total = 0;
+    uint32_t slowest = 0;
+
+    for (uint16_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+    {
+        unsigned long start = micros();
+
+        for (uint8_t owner = 0; owner < COMPOSITOR_LAYERS; owner++)
+        {
+            memset(_pixels, 0, sizeof(_pixels));
+            _pool.update(owner, STRIP_PIXELS);
+            _pool.emit(owner, LightEffect::confetti, 0, STRIP_PIXELS, frame);
+            _pool.render(owner, _pixels, STRIP_PIXELS);
+        }
+
+        uint32_t elapsed = micros() - start;
+        total += elapsed;
+        slowest = max(slowest, elapsed);
+        peak = max(peak, _pool.getCount());
+
+        for (uint8_t owner = 0; owner < COMPOSITOR_LAYERS; owner++)
+            TEST_ASSERT_LESS_OR_EQUAL(PARTICLES_PER_OWNER, _pool.getCount(owner));
+    }
+
+    uint32_t average = total / BENCHMARK_FRAMES;
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u owners, peak %u particles alive: avg %u us, max %u us per frame",
+             (unsigned)COMPOSITOR_LAYERS, (unsigned)peak, (unsigned)average, (unsigned)slowest);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(300, peak);
+    TEST_ASSERT_EQUAL(_pool.getCount(), sumOwners(&_pool, COMPOSITOR_LAYERS));
+    TEST_ASSERT_LESS_THAN(FRAME_INTERVAL_MILLIS * 1000 / 4, average);
+}
+
+int runUnityTests(void)
+{
+    if (!_pool.setup(COMPOSITOR_LAYERS, PARTICLES_PER_OWNER) || !_small.setup(2, SMALL_SHARE))
+        return 1;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_share_caps_every_owner);
+    RUN_TEST(test_update_retires_expired_particles);
+    RUN_TEST(test_clear_and_transfer_keep_the_counts);
+    RUN_TEST(test_render_only_adds_the_owner);
+    RUN_TEST(test_particle_benchmark);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    // the board needs a moment before the test runner listens on the serial port
+    delay(2000);
+    runUnityTests();
+}
+
+void loop()
+{
+}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif